@@ -1,14 +1,57 @@
 #ifndef K_DEBUG_H
 #define K_DEBUG_H
 
-/** helper for debug output */
+/**
+ * helper for debug output and tracing.
+ *
+ * what is compiled in depends on K_LOG_LEVEL (define it before including anything):
+ *	K_LOG_NONE		nothing at all
+ *	K_LOG_INFO		text messages for setup/shutdown (std::cout)
+ *	K_LOG_TRACE		+ binary trace-points within the capture/convert/encode paths (default)
+ *	K_LOG_VERBOSE	+ text messages for every image (slow!)
+ *
+ * trace-points only record something while the Tracer is started (see Trace.h)
+ */
 
 #include <stdlib.h>
 #include <iostream>
 
+#define K_LOG_NONE		0
+#define K_LOG_INFO		1
+#define K_LOG_TRACE		2
+#define K_LOG_VERBOSE	3
+
+#ifndef K_LOG_LEVEL
+#define K_LOG_LEVEL		K_LOG_TRACE
+#endif
+
+#if K_LOG_LEVEL >= K_LOG_INFO
 #define debug(src, msg)				std::cout << "[" << src << "] " << msg << std::endl;
-//#define debug(msg)				std::cout << msg << std::endl;
 #define debugBool(src, msg, val)	std::cout << "[" << src << "] " << msg << std::string( (val) ? "true" : "false" ) << std::endl;
+#else
+#define debug(src, msg)
+#define debugBool(src, msg, val)
+#endif
+//#define debug(msg)				std::cout << msg << std::endl;
+
+#if K_LOG_LEVEL >= K_LOG_VERBOSE
+#define debugVerbose(src, msg)		std::cout << "[" << src << "] " << msg << std::endl;
+#else
+#define debugVerbose(src, msg)
+#endif
+
+#if K_LOG_LEVEL >= K_LOG_TRACE
+#include "Trace.h"
+#define K_TRACE_CONCAT2(a, b)		a ## b
+#define K_TRACE_CONCAT(a, b)		K_TRACE_CONCAT2(a, b)
+// record one event (name must be a string literal)
+#define traceEvent(name, arg0, arg1)	do {if (K::Tracer::get().isEnabled()) {K::Tracer::get().record(K::TraceType::INSTANT, name, arg0, arg1);}} while(0)
+// record the begin and end of the current scope
+#define traceScope(name, arg0)			K::TraceScope K_TRACE_CONCAT(_traceScope, __LINE__)(name, arg0)
+#else
+#define traceEvent(name, arg0, arg1)	do {} while(0)
+#define traceScope(name, arg0)			do {} while(0)
+#endif
 
 
 // print an error and exit
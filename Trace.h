@@ -0,0 +1,370 @@
+#ifndef K_TRACE_H
+#define K_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+namespace K {
+
+	/** the kind of a trace event */
+	enum class TraceType : uint8_t {
+
+		/** something happened (e.g. an image was captured) */
+		INSTANT,
+
+		/** a stage (e.g. a conversion) started */
+		BEGIN,
+
+		/** a stage (e.g. a conversion) ended */
+		END,
+
+	};
+
+	/**
+	 * one binary trace event.
+	 * recording one is just a copy into the thread's ring.
+	 * formatting happens later (if at all), within the sink.
+	 */
+	struct TraceEvent {
+
+		/** when the event happened (CLOCK_MONOTONIC, nanoseconds) */
+		uint64_t timeNS;
+
+		/** the event's name. must be a string literal (or live as long as the Tracer) */
+		const char* name;
+
+		/** two event-specific values (e.g. sequence number and driver timestamp) */
+		uint64_t arg0;
+		uint64_t arg1;
+
+		/** the number of the recording thread (counted by the Tracer) */
+		uint32_t thread;
+
+		/** the kind of event */
+		TraceType type;
+
+	};
+
+	/**
+	 * lock-free single-producer/single-consumer ring of trace events.
+	 * the producer is the thread the ring belongs to, the consumer the Tracer's drain thread.
+	 * when the ring is full, new events are discarded (and counted).
+	 */
+	class TraceRing {
+
+	public:
+
+		/** the number of events one ring can hold (power of 2) */
+		static constexpr uint32_t SIZE = 4096;
+
+		/** ctor */
+		TraceRing(const uint32_t thread) : thread(thread), head(0), tail(0), numLost(0), orphaned(false) {;}
+
+		/** append one event (producer only) */
+		void push(const TraceEvent& e) {
+			const uint32_t h = head.load(std::memory_order_relaxed);
+			if (h - tail.load(std::memory_order_acquire) >= SIZE) {numLost.fetch_add(1, std::memory_order_relaxed); return;}
+			events[h & (SIZE-1)] = e;
+			head.store(h + 1, std::memory_order_release);
+		}
+
+		/** remove up to max events (consumer only). @return the number of events copied to dst */
+		uint32_t pop(TraceEvent* dst, const uint32_t max) {
+			const uint32_t t = tail.load(std::memory_order_relaxed);
+			const uint32_t h = head.load(std::memory_order_acquire);
+			uint32_t num = h - t;
+			if (num > max) {num = max;}
+			for (uint32_t i = 0; i < num; ++i) {dst[i] = events[(t + i) & (SIZE-1)];}
+			tail.store(t + num, std::memory_order_release);
+			return num;
+		}
+
+		/** the number of the thread this ring belongs to */
+		const uint32_t thread;
+
+	private:
+
+		friend class Tracer;
+
+		TraceEvent events[SIZE];
+
+		/** written by the producer only */
+		std::atomic<uint32_t> head;
+
+		/** written by the consumer only */
+		std::atomic<uint32_t> tail;
+
+		/** the number of events discarded because the ring was full */
+		std::atomic<uint64_t> numLost;
+
+		/** the thread the ring belongs to has ended */
+		std::atomic<bool> orphaned;
+
+	};
+
+	/** receives the recorded events from the Tracer's drain thread */
+	class TraceSink {
+
+	public:
+
+		/** dtor */
+		virtual ~TraceSink() {;}
+
+		/**
+		 * handle some events. the events of each thread arrive in order,
+		 * events of different threads might interleave (sort by timeNS if needed)
+		 */
+		virtual void write(const TraceEvent* events, const uint32_t num) = 0;
+
+		/** called when tracing stops */
+		virtual void flush() {;}
+
+	};
+
+	/** writes one line of text per event: "time thread type name arg0 arg1" */
+	class TraceSinkStream : public TraceSink {
+
+	public:
+
+		/** ctor */
+		TraceSinkStream(std::ostream& out) : out(out) {;}
+
+		void write(const TraceEvent* events, const uint32_t num) override {
+			static const char types[] = {'I', 'B', 'E'};
+			for (uint32_t i = 0; i < num; ++i) {
+				const TraceEvent& e = events[i];
+				out << e.timeNS << ' ' << e.thread << ' ' << types[(int) e.type] << ' ' << e.name << ' ' << e.arg0 << ' ' << e.arg1 << '\n';
+			}
+		}
+
+		void flush() override {out.flush();}
+
+	private:
+
+		std::ostream& out;
+
+	};
+
+	/**
+	 * low-overhead tracing of the capture/convert/encode stages.
+	 *
+	 * each thread records binary events into its own lock-free ring.
+	 * a background thread drains all rings every few milliseconds
+	 * and hands the events to a TraceSink.
+	 *
+	 * while tracing is stopped, each trace-point costs one relaxed atomic load.
+	 * while running, one clock_gettime() and a copy into the ring.
+	 * use the trace...() macros from Debug.h, which compile to nothing
+	 * for K_LOG_LEVEL < K_LOG_TRACE.
+	 *
+	 * usage:
+	 *	K::TraceSinkStream sink(file);
+	 *	K::Tracer::get().start(&sink);
+	 *	...
+	 *	K::Tracer::get().stop();
+	 */
+	class Tracer {
+
+	public:
+
+		/** get the tracer */
+		static Tracer& get() {
+			static Tracer tracer;
+			return tracer;
+		}
+
+		/** dtor */
+		~Tracer() {
+			stop();
+		}
+
+		/**
+		 * start recording events and handing them to the given sink
+		 * @param sink the sink to write to. must live until stop() returns
+		 * @param intervalMS how often to drain the threads' rings
+		 */
+		void start(TraceSink* sink, const uint32_t intervalMS = 10) {
+			std::lock_guard<std::mutex> lock(control);
+			if (thread.joinable()) {return;}
+			this->sink = sink;
+			this->intervalMS = intervalMS;
+			running = true;
+			thread = std::thread(&Tracer::run, this);
+			enabled.store(true, std::memory_order_relaxed);
+		}
+
+		/** stop recording. all events recorded so far are written to the sink */
+		void stop() {
+			std::lock_guard<std::mutex> lock(control);
+			if (!thread.joinable()) {return;}
+			enabled.store(false, std::memory_order_relaxed);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				running = false;
+			}
+			wake.notify_all();
+			thread.join();
+			sink = nullptr;
+		}
+
+		/** are events currently recorded? */
+		bool isEnabled() const {return enabled.load(std::memory_order_relaxed);}
+
+		/** record one event for the calling thread */
+		void record(const TraceType type, const char* name, const uint64_t arg0 = 0, const uint64_t arg1 = 0) {
+			TraceRing& ring = getLocalRing();
+			TraceEvent e;
+			e.timeNS = nowNS();
+			e.name = name;
+			e.arg0 = arg0;
+			e.arg1 = arg1;
+			e.thread = ring.thread;
+			e.type = type;
+			ring.push(e);
+		}
+
+		/** get the number of events discarded so far, because a thread's ring was full */
+		uint64_t getNumLost() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			uint64_t num = numLost;
+			for (const std::shared_ptr<TraceRing>& ring : rings) {num += ring->numLost.load(std::memory_order_relaxed);}
+			return num;
+		}
+
+		/** the clock used for all events (CLOCK_MONOTONIC, same as the drivers' timestamps) */
+		static uint64_t nowNS() {
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+		}
+
+	private:
+
+		/** ctor */
+		Tracer() : enabled(false), sink(nullptr), intervalMS(10), running(false), numThreads(0), numLost(0) {;}
+
+		/** hidden copy ctor */
+		Tracer(const Tracer&);
+
+		/** hidden assignment operator */
+		Tracer& operator = (const Tracer&);
+
+		/** keeps the calling thread's ring and marks it as orphaned when the thread ends */
+		struct LocalRing {
+			std::shared_ptr<TraceRing> ring;
+			LocalRing(Tracer& tracer) : ring(tracer.addRing()) {;}
+			~LocalRing() {ring->orphaned.store(true, std::memory_order_release);}
+		};
+
+		/** get the calling thread's ring (created on first use) */
+		TraceRing& getLocalRing() {
+			thread_local LocalRing local(*this);
+			return *local.ring;
+		}
+
+		/** create a ring for a new thread */
+		std::shared_ptr<TraceRing> addRing() {
+			std::lock_guard<std::mutex> lock(mutex);
+			std::shared_ptr<TraceRing> ring(new TraceRing(numThreads++));
+			rings.push_back(ring);
+			return ring;
+		}
+
+		/** the drain thread */
+		void run() {
+			std::unique_lock<std::mutex> lock(mutex);
+			while (running) {
+				wake.wait_for(lock, std::chrono::milliseconds(intervalMS));
+				drain();
+			}
+			drain();
+			sink->flush();
+		}
+
+		/** move all recorded events to the sink (mutex must be held) */
+		void drain() {
+
+			TraceEvent buf[256];
+			for (size_t i = 0; i < rings.size(); ) {
+
+				TraceRing& ring = *rings[i];
+				const bool orphaned = ring.orphaned.load(std::memory_order_acquire);
+				uint32_t num;
+				while ((num = ring.pop(buf, 256)) > 0) {sink->write(buf, num);}
+
+				// the thread has ended and everything was written -> forget the ring
+				if (orphaned) {
+					numLost += ring.numLost.load(std::memory_order_relaxed);
+					rings.erase(rings.begin() + i);
+				} else {
+					++i;
+				}
+
+			}
+
+		}
+
+
+		/** checked by all trace-points */
+		std::atomic<bool> enabled;
+
+		/** serializes start() and stop() */
+		std::mutex control;
+
+		/** protects everything below */
+		mutable std::mutex mutex;
+		std::condition_variable wake;
+
+		std::thread thread;
+		TraceSink* sink;
+		uint32_t intervalMS;
+		bool running;
+
+		/** the rings of all threads that recorded events */
+		std::vector<std::shared_ptr<TraceRing>> rings;
+		uint32_t numThreads;
+
+		/** events lost by already ended threads */
+		uint64_t numLost;
+
+	};
+
+	/** records BEGIN on construction and END on destruction (if tracing is enabled) */
+	class TraceScope {
+
+	public:
+
+		/** ctor */
+		TraceScope(const char* name, const uint64_t arg0 = 0) : name(name), active(Tracer::get().isEnabled()) {
+			if (active) {Tracer::get().record(TraceType::BEGIN, name, arg0);}
+		}
+
+		/** dtor */
+		~TraceScope() {
+			if (active) {Tracer::get().record(TraceType::END, name);}
+		}
+
+	private:
+
+		const char* name;
+		const bool active;
+
+		/** hidden copy ctor */
+		TraceScope(const TraceScope&);
+
+		/** hidden assignment operator */
+		TraceScope& operator = (const TraceScope&);
+
+	};
+
+}
+
+#endif // K_TRACE_H
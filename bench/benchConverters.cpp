@@ -0,0 +1,395 @@
+/**
+ * micro-benchmark for the image converters using deterministic synthetic frames
+ * at common resolutions (VGA, 720p, 1080p, 4K).
+ *
+ * compile (from the repository's root):
+ *		g++ -std=c++11 -O2 -march=native bench/benchConverters.cpp -o benchConverters -ljpeg -lz -pthread
+ *
+ * usage:
+ *		./benchConverters [--csv | --json] [--out file] [--label text] [--threads n]
+ *		                  [--simd scalar|sse2|ssse3|avx2] [--min-time seconds] [--filter text]
+ *
+ *		--csv / --json	output format (default: csv)
+ *		--out			write the results to the given file instead of stdout
+ *		--label			e.g. the commit's hash, to compare several runs
+ *		--threads		the number of threads for the converters (default: 1 = no thread-pool)
+ *		--simd			limit the SIMD level
+ *		--min-time		measure each converter for at least this long (default: 0.5)
+ *		--filter		only run converters whose name contains the given text
+ *
+ * for each converter and resolution, the following is reported:
+ *		iterations, ms per frame, MPix/s, ns per pixel,
+ *		bytes allocated by the first (warm-up) frame and bytes allocated per
+ *		following frame (heap allocations via new and the memory DataBuffers
+ *		got from the system, i.e. not recycled by the buffer pool)
+ */
+
+// the counting operator new / delete below are based on malloc / free
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+	#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+#include "../Debug.h"
+#include "../image/WebcamImage.h"
+#include "../image/ThreadPool.h"
+#include "../image/converters/SIMD.h"
+#include "../image/converters/YUYV_RGB24.h"
+#include "../image/converters/YUV420_RGB24.h"
+#include "../image/converters/Yxx_RGB24.h"
+#include "../image/converters/Yxx_Yxx.h"
+#include "../image/converters/MJPEG_JPEG.h"
+#include "../image/converters/JPEG.h"
+#include "../image/converters/JPEGDecoder.h"
+#include "../image/converters/PNG.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+/** all heap allocations via new (std::vector, std::string, ...) */
+static std::atomic<uint64_t> heapBytes(0);
+
+void* operator new (size_t size) {
+	heapBytes += size;
+	void* ptr = malloc(size);
+	if (!ptr) {throw std::bad_alloc();}
+	return ptr;
+}
+
+void operator delete (void* ptr) noexcept {
+	free(ptr);
+}
+
+void operator delete (void* ptr, size_t) noexcept {
+	free(ptr);
+}
+
+using namespace K;
+
+/** deterministic pseudo-random numbers */
+struct XorShift {
+	uint32_t state;
+	XorShift(const uint32_t seed) : state(seed) {;}
+	uint32_t next() {state ^= state << 13; state ^= state >> 17; state ^= state << 5; return state;}
+};
+
+/** a smooth gradient with some noise, somewhat like a camera image */
+static inline uint8_t getSample(XorShift& rnd, const uint32_t x, const uint32_t y, const uint32_t w, const uint32_t h, const uint32_t channel) {
+	const uint32_t base = (x * 160 / w) + (y * 80 / h) + channel * 16;
+	return (uint8_t) (base + (rnd.next() & 7));
+}
+
+/** create a synthetic frame with the given size and pixel format */
+static void createFrame(WebcamImage& img, const uint32_t w, const uint32_t h, const uint32_t format) {
+
+	XorShift rnd(w * 31 + h);
+	uint32_t size = 0;
+	switch (format) {
+		case V4L2_PIX_FMT_YUYV:		size = w*h*2; break;
+		case V4L2_PIX_FMT_YUV420:	size = w*h + 2*((w+1)/2)*((h+1)/2); break;
+		case V4L2_PIX_FMT_Y12:		size = w*h*2; break;
+		case V4L2_PIX_FMT_RGB24:	size = w*h*3; break;
+		case V4L2_PIX_FMT_GREY:		size = w*h; break;
+	}
+
+	img.ensureSpace(size);
+	uint8_t* data = img.getData();
+
+	switch (format) {
+
+		case V4L2_PIX_FMT_YUYV:
+			for (uint32_t y = 0; y < h; ++y) {
+				for (uint32_t x = 0; x < w; ++x) {
+					data[(y*w+x)*2+0] = getSample(rnd, x, y, w, h, 0);
+					data[(y*w+x)*2+1] = 128 + (getSample(rnd, x, y, w, h, (x & 1) + 1) >> 2) - 32;
+				}
+			}
+			break;
+
+		case V4L2_PIX_FMT_YUV420: {
+			const uint32_t cw = (w+1) / 2;
+			const uint32_t ch = (h+1) / 2;
+			for (uint32_t y = 0; y < h; ++y) {
+				for (uint32_t x = 0; x < w; ++x) {data[y*w+x] = getSample(rnd, x, y, w, h, 0);}
+			}
+			for (uint32_t i = 0; i < 2*cw*ch; ++i) {
+				const uint32_t x = (i % cw) * 2;
+				const uint32_t y = ((i / cw) % ch) * 2;
+				data[w*h+i] = 128 + (getSample(rnd, x, y, w, h, 1 + i / (cw*ch)) >> 2) - 32;
+			}
+			break;
+		}
+
+		case V4L2_PIX_FMT_Y12:
+			for (uint32_t y = 0; y < h; ++y) {
+				for (uint32_t x = 0; x < w; ++x) {
+					const uint16_t val = (uint16_t) ((getSample(rnd, x, y, w, h, 0) << 4) | (rnd.next() & 15));
+					data[(y*w+x)*2+0] = (uint8_t) (val >> 0);
+					data[(y*w+x)*2+1] = (uint8_t) (val >> 8);
+				}
+			}
+			break;
+
+		case V4L2_PIX_FMT_RGB24:
+			for (uint32_t y = 0; y < h; ++y) {
+				for (uint32_t x = 0; x < w; ++x) {
+					for (uint32_t c = 0; c < 3; ++c) {data[(y*w+x)*3+c] = getSample(rnd, x, y, w, h, c);}
+				}
+			}
+			break;
+
+		case V4L2_PIX_FMT_GREY:
+			for (uint32_t i = 0; i < w*h; ++i) {data[i] = getSample(rnd, i % w, i / w, w, h, 0);}
+			break;
+
+	}
+
+	img.setParameters(w, h, PixelFormat(format), size);
+
+}
+
+/** create a synthetic MJPEG frame: a JPEG without its huffman-tables */
+static void createMJPEG(WebcamImage& img, const uint32_t w, const uint32_t h) {
+
+	WebcamImage yuyv;
+	WebcamImage jpeg;
+	createFrame(yuyv, w, h, V4L2_PIX_FMT_YUYV);
+	convertYUYVtoJPEG(yuyv, jpeg, 85);
+
+	// copy all segments up to the SOS, except the DHTs, then the entropy-coded data
+	const uint8_t* src = jpeg.getData();
+	const uint32_t len = jpeg.getNumBytes();
+	img.ensureSpace(len);
+	uint8_t* dst = img.getData();
+	memcpy(dst, src, 2);
+	uint32_t pos = 2;
+	uint32_t out = 2;
+	while (pos + 4 <= len && src[pos+1] != JPEG_MARKER_SOS) {
+		const uint32_t segLength = 2 + (((uint32_t) src[pos+2] << 8) | src[pos+3]);
+		if (src[pos+1] != JPEG_MARKER_DHT) {memcpy(dst + out, src + pos, segLength); out += segLength;}
+		pos += segLength;
+	}
+	memcpy(dst + out, src + pos, len - pos);
+	out += len - pos;
+
+	img.setParameters(w, h, PixelFormat(V4L2_PIX_FMT_MJPEG), out);
+
+}
+
+/** one converter to benchmark */
+struct Converter {
+	std::string name;
+	uint32_t inputFormat;
+	std::function<void(const WebcamImage& src, WebcamImage& dst)> convert;
+};
+
+/** the measurements for one converter and resolution */
+struct Result {
+	std::string converter;
+	std::string resolution;
+	uint32_t width;
+	uint32_t height;
+	uint32_t iterations;
+	double msPerFrame;
+	double mpixPerSec;
+	double nsPerPixel;
+	uint64_t bytesFirst;
+	uint64_t bytesPerFrame;
+};
+
+/** all bytes allocated so far */
+static uint64_t getAllocatedBytes() {
+	return heapBytes + DataBuffer::getStats().numBytes;
+}
+
+static const char* getSIMDName(const SIMDLevel level) {
+	switch (level) {
+		case SIMDLevel::SCALAR:		return "scalar";
+		case SIMDLevel::SSE2:		return "sse2";
+		case SIMDLevel::SSSE3:		return "ssse3";
+		case SIMDLevel::AVX2:		return "avx2";
+	}
+	return "?";
+}
+
+static Result run(const Converter& conv, const WebcamImage& src, const char* resolution, const double minTime) {
+
+	Result res;
+	res.converter = conv.name;
+	res.resolution = resolution;
+	res.width = src.getWidth();
+	res.height = src.getHeight();
+
+	WebcamImage dst;
+
+	// warm-up: allocates the output and the converter's state
+	const uint64_t bytes0 = getAllocatedBytes();
+	conv.convert(src, dst);
+	res.bytesFirst = getAllocatedBytes() - bytes0;
+
+	// measure
+	typedef std::chrono::steady_clock Clock;
+	const uint64_t bytes1 = getAllocatedBytes();
+	const Clock::time_point start = Clock::now();
+	double elapsed = 0;
+	uint32_t iterations = 0;
+	while (iterations < 3 || elapsed < minTime) {
+		conv.convert(src, dst);
+		++iterations;
+		elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	const double pixels = (double) res.width * res.height;
+	res.iterations = iterations;
+	res.msPerFrame = elapsed * 1000 / iterations;
+	res.mpixPerSec = pixels * iterations / elapsed / 1e6;
+	res.nsPerPixel = elapsed * 1e9 / iterations / pixels;
+	res.bytesPerFrame = (getAllocatedBytes() - bytes1) / iterations;
+	return res;
+
+}
+
+/** the given text as JSON string (including the quotes) */
+static std::string toJSON(const std::string& str) {
+	std::string res = "\"";
+	for (const char c : str) {
+		if		(c == '"' || c == '\\')	{res += '\\'; res += c;}
+		else if ((unsigned char) c < 0x20)	{char buf[8]; snprintf(buf, sizeof(buf), "\\u%04x", c); res += buf;}
+		else								{res += c;}
+	}
+	return res + "\"";
+}
+
+/** the given text as CSV field: quoted (with doubled quotes) if needed */
+static std::string toCSV(const std::string& str) {
+	if (str.find_first_of(",\"\r\n") == std::string::npos) {return str;}
+	std::string res = "\"";
+	for (const char c : str) {
+		if (c == '"') {res += '"';}
+		res += c;
+	}
+	return res + "\"";
+}
+
+int main(int argc, char** argv) {
+
+	bool json = false;
+	std::string outFile;
+	std::string label;
+	std::string filter;
+	uint32_t numThreads = 1;
+	double minTime = 0.5;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool hasValue = (i + 1 < argc);
+		if		(arg == "--csv")					{json = false;}
+		else if (arg == "--json")					{json = true;}
+		else if (arg == "--out" && hasValue)		{outFile = argv[++i];}
+		else if (arg == "--label" && hasValue)		{label = argv[++i];}
+		else if (arg == "--filter" && hasValue)		{filter = argv[++i];}
+		else if (arg == "--threads" && hasValue)	{numThreads = (uint32_t) atoi(argv[++i]);}
+		else if (arg == "--min-time" && hasValue)	{minTime = atof(argv[++i]);}
+		else if (arg == "--simd" && hasValue) {
+			const std::string simd = argv[++i];
+			if		(simd == "scalar")	{setSIMDLevel(SIMDLevel::SCALAR);}
+			else if (simd == "sse2")	{setSIMDLevel(SIMDLevel::SSE2);}
+			else if (simd == "ssse3")	{setSIMDLevel(SIMDLevel::SSSE3);}
+			else if (simd == "avx2")	{setSIMDLevel(SIMDLevel::AVX2);}
+			else {
+				fprintf(stderr, "unknown SIMD level: %s (use scalar, sse2, ssse3 or avx2)\n", simd.c_str());
+				return 1;
+			}
+		} else {
+			fprintf(stderr, "unknown argument: %s (see the comment at the top of benchConverters.cpp)\n", argv[i]);
+			return 1;
+		}
+	}
+
+	// the converters' debug output would dominate the timings
+	std::cout.setstate(std::ios::badbit);
+
+	std::unique_ptr<ThreadPool> pool;
+	if (numThreads != 1) {pool.reset(new ThreadPool(numThreads));}
+	ThreadPool* tp = pool.get();
+
+	// persistent encoders / decoders (as used by the ImageConverter)
+	JPEGEncoder jpegEncoder;
+	JPEGDecoder jpegDecoder;
+	PNGEncoder pngEncoder(PNGSettings::fastest());
+
+	const std::vector<Converter> converters = {
+		{"convertYUYVtoRGB24",		V4L2_PIX_FMT_YUYV,		[&] (const WebcamImage& s, WebcamImage& d) {convertYUYVtoRGB24(s, d, tp);}},
+		{"convertYUV420toRGB24",	V4L2_PIX_FMT_YUV420,	[&] (const WebcamImage& s, WebcamImage& d) {convertYUV420toRGB24(s, d, tp);}},
+		{"convertYxxToRGB24",		V4L2_PIX_FMT_Y12,		[&] (const WebcamImage& s, WebcamImage& d) {convertYxxToRGB24(12, s, d, tp);}},
+		{"convertYxxToY08",			V4L2_PIX_FMT_Y12,		[&] (const WebcamImage& s, WebcamImage& d) {convertYxxToY08(12, s, d, tp);}},
+		{"convertMJPEGtoJPEG",		V4L2_PIX_FMT_MJPEG,		[&] (const WebcamImage& s, WebcamImage& d) {convertMJPEGtoJPEG(s, d);}},
+		{"convertToJPEG",			V4L2_PIX_FMT_RGB24,		[&] (const WebcamImage& s, WebcamImage& d) {convertToJPEG(s, d, 85, tp);}},
+		{"convertToPNG",			V4L2_PIX_FMT_RGB24,		[&] (const WebcamImage& s, WebcamImage& d) {convertToPNG(s, d);}},
+		{"JPEGEncoder(YUYV)",		V4L2_PIX_FMT_YUYV,		[&] (const WebcamImage& s, WebcamImage& d) {jpegEncoder.encode(s, d, 85, tp);}},
+		{"JPEGEncoder(RGB24)",		V4L2_PIX_FMT_RGB24,		[&] (const WebcamImage& s, WebcamImage& d) {jpegEncoder.encode(s, d, 85, tp);}},
+		{"JPEGDecoder(RGB24)",		V4L2_PIX_FMT_MJPEG,		[&] (const WebcamImage& s, WebcamImage& d) {jpegDecoder.decodeRGB(s, d);}},
+		{"PNGEncoder(fastest)",		V4L2_PIX_FMT_RGB24,		[&] (const WebcamImage& s, WebcamImage& d) {pngEncoder.encode(s, d, tp);}},
+	};
+
+	struct Resolution {const char* name; uint32_t w; uint32_t h;};
+	const std::vector<Resolution> resolutions = {
+		{"VGA", 640, 480},
+		{"720p", 1280, 720},
+		{"1080p", 1920, 1080},
+		{"4K", 3840, 2160},
+	};
+
+	std::vector<Result> results;
+	for (const Resolution& r : resolutions) {
+		for (const Converter& c : converters) {
+
+			if (!filter.empty() && c.name.find(filter) == std::string::npos) {continue;}
+
+			WebcamImage src;
+			if (c.inputFormat == V4L2_PIX_FMT_MJPEG)	{createMJPEG(src, r.w, r.h);}
+			else										{createFrame(src, r.w, r.h, c.inputFormat);}
+
+			fprintf(stderr, "%-24s %-6s ...", c.name.c_str(), r.name);
+			results.push_back(run(c, src, r.name, minTime));
+			fprintf(stderr, " %8.2f MPix/s\n", results.back().mpixPerSec);
+
+		}
+	}
+
+	FILE* out = (outFile.empty()) ? (stdout) : (fopen(outFile.c_str(), "w"));
+	if (!out) {fprintf(stderr, "could not open %s\n", outFile.c_str()); return 1;}
+
+	const char* simd = getSIMDName(getSIMDLevel());
+	const uint32_t threads = (tp) ? (tp->getNumThreads()) : (1);
+
+	if (json) {
+		fprintf(out, "{\n\t\"label\": %s,\n\t\"simd\": \"%s\",\n\t\"threads\": %u,\n\t\"results\": [\n", toJSON(label).c_str(), simd, threads);
+		for (size_t i = 0; i < results.size(); ++i) {
+			const Result& r = results[i];
+			fprintf(out, "\t\t{\"converter\": \"%s\", \"resolution\": \"%s\", \"width\": %u, \"height\": %u, \"iterations\": %u, "
+						 "\"ms_per_frame\": %.4f, \"mpix_per_s\": %.3f, \"ns_per_pixel\": %.4f, \"bytes_first\": %llu, \"bytes_per_frame\": %llu}%s\n",
+					r.converter.c_str(), r.resolution.c_str(), r.width, r.height, r.iterations,
+					r.msPerFrame, r.mpixPerSec, r.nsPerPixel, (unsigned long long) r.bytesFirst, (unsigned long long) r.bytesPerFrame,
+					(i + 1 < results.size()) ? (",") : (""));
+		}
+		fprintf(out, "\t]\n}\n");
+	} else {
+		fprintf(out, "label,simd,threads,converter,resolution,width,height,iterations,ms_per_frame,mpix_per_s,ns_per_pixel,bytes_first,bytes_per_frame\n");
+		for (const Result& r : results) {
+			fprintf(out, "%s,%s,%u,%s,%s,%u,%u,%u,%.4f,%.3f,%.4f,%llu,%llu\n",
+					toCSV(label).c_str(), simd, threads, r.converter.c_str(), r.resolution.c_str(), r.width, r.height, r.iterations,
+					r.msPerFrame, r.mpixPerSec, r.nsPerPixel, (unsigned long long) r.bytesFirst, (unsigned long long) r.bytesPerFrame);
+		}
+	}
+
+	if (out != stdout) {fclose(out);}
+	return 0;
+
+}
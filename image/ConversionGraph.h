@@ -0,0 +1,244 @@
+#ifndef K_CONVERSIONGRAPH_H
+#define K_CONVERSIONGRAPH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "WebcamImage.h"
+#include "PixelFormat.h"
+#include "ThreadPool.h"
+
+#include "converters/Yxx_RGB24.h"
+#include "converters/Yxx_Yxx.h"
+#include "converters/YUYV_RGB24.h"
+#include "converters/YUV420_RGB24.h"
+#include "converters/YUV420_YUV24.h"
+#include "converters/MJPEG_JPEG.h"
+#include "converters/JPEGEncoder.h"
+#include "converters/JPEGDecoder.h"
+
+namespace K {
+
+	/** everything a conversion might need, besides its source and destination */
+	struct ConversionContext {
+
+		/** the threads to use (if any) */
+		ThreadPool* pool;
+
+		/** persistent JPEG compressor / decompressor */
+		JPEGEncoder* jpegEncoder;
+		JPEGDecoder* jpegDecoder;
+
+		/** the quality for conversions to JPEG */
+		uint8_t quality;
+
+	};
+
+	/**
+	 * one direct conversion between two pixel formats.
+	 * convert() returns the converted image: dst, or src itself if nothing had to be done
+	 */
+	struct ConversionEdge {
+
+		/** source and destination pixel format */
+		uint32_t from;
+		uint32_t to;
+
+		/** estimated cost of the conversion (roughly nanoseconds per pixel) */
+		uint32_t cost;
+
+		/** lossy conversions (encoding) are only used as the last step of a chain */
+		bool lossy;
+
+		/** for debugging */
+		const char* name;
+
+		/** perform the conversion */
+		const WebcamImage& (*convert) (ConversionContext& ctx, const WebcamImage& src, WebcamImage& dst);
+
+	};
+
+	/**
+	 * all direct conversions between pixel formats and the cheapest
+	 * chain of conversions between each pair of them.
+	 *
+	 * the table is built once (on first use) from the edges below.
+	 * adding a new (fast-path) conversion only needs a new edge.
+	 *
+	 * lossy conversions are never used as an intermediate step
+	 * (e.g. GREY -> JPEG -> RGB24).
+	 */
+	class ConversionGraph {
+
+	public:
+
+		/** a chain of conversions. empty if source and destination format are the same */
+		typedef std::vector<const ConversionEdge*> Path;
+
+		/** get the graph */
+		static const ConversionGraph& get() {
+			static ConversionGraph graph;
+			return graph;
+		}
+
+		/** get all direct conversions */
+		const std::vector<ConversionEdge>& getEdges() const {return edges;}
+
+		/** get the cheapest chain of conversions from -> to. nullptr if there is none */
+		const Path* getPath(const uint32_t from, const uint32_t to) const {
+			if (from == to) {return &empty;}
+			const int i = getIndex(from);
+			const int j = getIndex(to);
+			if (i < 0 || j < 0 || !reachable[i*numFormats + j]) {return nullptr;}
+			return &paths[i*numFormats + j];
+		}
+
+		/** get the total cost of a chain of conversions */
+		static uint32_t getCost(const Path& path) {
+			uint32_t cost = 0;
+			for (const ConversionEdge* e : path) {cost += e->cost;}
+			return cost;
+		}
+
+	private:
+
+		/** ctor. build the table of cheapest paths */
+		ConversionGraph() : edges(getConversionEdges()) {
+
+			for (const ConversionEdge& e : edges) {
+				if (getIndex(e.from) < 0) {formats.push_back(e.from);}
+				if (getIndex(e.to) < 0) {formats.push_back(e.to);}
+			}
+			numFormats = (uint32_t) formats.size();
+
+			// the cheapest direct (lossless) conversion between each pair
+			const uint32_t n = numFormats;
+			std::vector<uint32_t> cost(n*n, UINT32_MAX);
+			std::vector<int> next(n*n, -1);			// the first edge on the cheapest path i -> j
+			for (uint32_t i = 0; i < edges.size(); ++i) {
+				const uint32_t a = getIndex(edges[i].from);
+				const uint32_t b = getIndex(edges[i].to);
+				if (!edges[i].lossy && edges[i].cost < cost[a*n+b]) {cost[a*n+b] = edges[i].cost; next[a*n+b] = i;}
+			}
+
+			// floyd-warshall (lossless conversions only)
+			for (uint32_t k = 0; k < n; ++k) {
+				for (uint32_t i = 0; i < n; ++i) {
+					for (uint32_t j = 0; j < n; ++j) {
+						if (i == j || cost[i*n+k] == UINT32_MAX || cost[k*n+j] == UINT32_MAX) {continue;}
+						const uint32_t c = cost[i*n+k] + cost[k*n+j];
+						if (c < cost[i*n+j]) {cost[i*n+j] = c; next[i*n+j] = next[i*n+k];}
+					}
+				}
+			}
+
+			// unroll the paths
+			paths.resize(n*n);
+			reachable.resize(n*n, false);
+			for (uint32_t i = 0; i < n; ++i) {
+				for (uint32_t j = 0; j < n; ++j) {
+					if (i == j || next[i*n+j] < 0) {continue;}
+					reachable[i*n+j] = true;
+					for (uint32_t cur = i; cur != j; ) {
+						const ConversionEdge* e = &edges[next[cur*n+j]];
+						paths[i*n+j].push_back(e);
+						cur = getIndex(e->to);
+					}
+				}
+			}
+
+			// a lossy conversion as the last step might be cheaper
+			for (uint32_t i = 0; i < n; ++i) {
+				for (const ConversionEdge& e : edges) {
+					if (!e.lossy) {continue;}
+					const uint32_t k = getIndex(e.from);
+					const uint32_t j = getIndex(e.to);
+					if (i == j) {continue;}
+					const uint32_t toK = (i == k) ? (0) : (cost[i*n+k]);
+					if (toK == UINT32_MAX || (reachable[i*n+j] && toK + e.cost >= cost[i*n+j])) {continue;}
+					cost[i*n+j] = toK + e.cost;
+					reachable[i*n+j] = true;
+					paths[i*n+j] = (i == k) ? (Path()) : (paths[i*n+k]);
+					paths[i*n+j].push_back(&e);
+				}
+			}
+
+		}
+
+		/** get the index of the given format. -1 if unknown */
+		int getIndex(const uint32_t format) const {
+			for (uint32_t i = 0; i < formats.size(); ++i) {
+				if (formats[i] == format) {return i;}
+			}
+			return -1;
+		}
+
+		/** all known direct conversions */
+		static std::vector<ConversionEdge> getConversionEdges() {
+
+			typedef ConversionContext Ctx;
+			typedef const WebcamImage Src;
+			typedef WebcamImage Dst;
+
+			return std::vector<ConversionEdge> {
+
+				// to RGB24
+				{V4L2_PIX_FMT_YUYV,		V4L2_PIX_FMT_RGB24,		2,	false,	"YUYV -> RGB24",	[] (Ctx& c, Src& s, Dst& d) -> Src& {convertYUYVtoRGB24(s, d, c.pool); return d;}},
+				{V4L2_PIX_FMT_YUV420,	V4L2_PIX_FMT_RGB24,		2,	false,	"YUV420 -> RGB24",	[] (Ctx& c, Src& s, Dst& d) -> Src& {convertYUV420toRGB24(s, d, c.pool); return d;}},
+				{V4L2_PIX_FMT_Y12,		V4L2_PIX_FMT_RGB24,		2,	false,	"Y12 -> RGB24",		[] (Ctx& c, Src& s, Dst& d) -> Src& {convertYxxToRGB24(12, s, d, c.pool); return d;}},
+				{V4L2_PIX_FMT_Y11,		V4L2_PIX_FMT_RGB24,		2,	false,	"Y11 -> RGB24",		[] (Ctx& c, Src& s, Dst& d) -> Src& {convertYxxToRGB24(11, s, d, c.pool); return d;}},
+				{V4L2_PIX_FMT_Y16,		V4L2_PIX_FMT_RGB24,		2,	false,	"Y16 -> RGB24",		[] (Ctx& c, Src& s, Dst& d) -> Src& {convertYxxToRGB24(16, s, d, c.pool); return d;}},
+				{V4L2_PIX_FMT_MJPEG,	V4L2_PIX_FMT_RGB24,		12,	false,	"MJPEG -> RGB24",	[] (Ctx& c, Src& s, Dst& d) -> Src& {c.jpegDecoder->decodeRGB(s, d); return d;}},
+				{V4L2_PIX_FMT_JPEG,		V4L2_PIX_FMT_RGB24,		12,	false,	"JPEG -> RGB24",	[] (Ctx& c, Src& s, Dst& d) -> Src& {c.jpegDecoder->decodeRGB(s, d); return d;}},
+
+				// to GREY
+				{V4L2_PIX_FMT_Y12,		V4L2_PIX_FMT_GREY,		1,	false,	"Y12 -> GREY",		[] (Ctx& c, Src& s, Dst& d) -> Src& {convertYxxToY08(12, s, d, c.pool); return d;}},
+				{V4L2_PIX_FMT_Y11,		V4L2_PIX_FMT_GREY,		1,	false,	"Y11 -> GREY",		[] (Ctx& c, Src& s, Dst& d) -> Src& {convertYxxToY08(11, s, d, c.pool); return d;}},
+				{V4L2_PIX_FMT_Y16,		V4L2_PIX_FMT_GREY,		1,	false,	"Y16 -> GREY",		[] (Ctx& c, Src& s, Dst& d) -> Src& {convertYxxToY08(16, s, d, c.pool); return d;}},
+
+				// to YUV24 (interleaved)
+				{V4L2_PIX_FMT_YUV420,	V4L2_PIX_FMT_YUV24,		2,	false,	"YUV420 -> YUV24",	[] (Ctx& c, Src& s, Dst& d) -> Src& {
+					convertYUV420toYUV24(s, d, c.pool);
+					d.setParameters(d.getWidth(), d.getHeight(), PixelFormat(V4L2_PIX_FMT_YUV24), d.getNumBytes());
+					return d;
+				}},
+
+				// to JPEG
+				{V4L2_PIX_FMT_GEPJ,		V4L2_PIX_FMT_JPEG,		0,	false,	"GEPJ -> JPEG",		[] (Ctx& c, Src& s, Dst& d) -> Src& {(void) c; (void) d; return s;}},		// is already a JPEG ;)
+				{V4L2_PIX_FMT_MJPEG,	V4L2_PIX_FMT_JPEG,		1,	false,	"MJPEG -> JPEG",	[] (Ctx& c, Src& s, Dst& d) -> Src& {(void) c; return getMJPEGasJPEG(s, d);}},
+				{V4L2_PIX_FMT_RGB24,	V4L2_PIX_FMT_JPEG,		10,	true,	"RGB24 -> JPEG",	[] (Ctx& c, Src& s, Dst& d) -> Src& {c.jpegEncoder->encode(s, d, c.quality, c.pool); return d;}},
+				{V4L2_PIX_FMT_GREY,		V4L2_PIX_FMT_JPEG,		4,	true,	"GREY -> JPEG",		[] (Ctx& c, Src& s, Dst& d) -> Src& {c.jpegEncoder->encode(s, d, c.quality, c.pool); return d;}},
+				{V4L2_PIX_FMT_YUV420,	V4L2_PIX_FMT_JPEG,		6,	true,	"YUV420 -> JPEG",	[] (Ctx& c, Src& s, Dst& d) -> Src& {c.jpegEncoder->encode(s, d, c.quality, c.pool); return d;}},
+				{V4L2_PIX_FMT_YUYV,		V4L2_PIX_FMT_JPEG,		7,	true,	"YUYV -> JPEG",		[] (Ctx& c, Src& s, Dst& d) -> Src& {c.jpegEncoder->encode(s, d, c.quality, c.pool); return d;}},
+				{V4L2_PIX_FMT_YUV24,	V4L2_PIX_FMT_JPEG,		9,	true,	"YUV24 -> JPEG",	[] (Ctx& c, Src& s, Dst& d) -> Src& {c.jpegEncoder->encodeYCbCr(s, d, c.quality, c.pool); return d;}},
+
+			};
+
+		}
+
+
+		/** all direct conversions */
+		const std::vector<ConversionEdge> edges;
+
+		/** all formats that appear within the edges */
+		std::vector<uint32_t> formats;
+		uint32_t numFormats;
+
+		/** the cheapest path [from*numFormats + to] */
+		std::vector<Path> paths;
+		std::vector<bool> reachable;
+
+		/** the path for from == to */
+		const Path empty;
+
+		/** hidden copy ctor */
+		ConversionGraph(const ConversionGraph&);
+
+		/** hidden assignment operator */
+		ConversionGraph& operator = (const ConversionGraph&);
+
+	};
+
+}
+
+#endif // K_CONVERSIONGRAPH_H
@@ -2,15 +2,19 @@
 #define K_DATABUFFER_H
 
 #include "ConverterException.h"
+#include "DataBufferAllocator.h"
+#include "../Debug.h"
+#include <atomic>
 #include <cstdint>
-#include <cstdlib>
-#include <string.h>
 
 namespace K {
 
 	/**
 	 * something like a std::vector but slightly different.
-	 * holds data and can be adjusted to the needed size
+	 * holds data and can be adjusted to the needed size.
+	 *
+	 * the memory is provided by a DataBufferAllocator (aligned, pooled by default)
+	 * and is not initialized.
 	 */
 	class DataBuffer {
 
@@ -28,10 +32,21 @@ namespace K {
 		/** the number of bytes in use */
 		uint32_t usedBytes;
 
+		/** does the data belong to this buffer? (false for views onto foreign memory) */
+		bool owner;
+
+		/** the allocator providing (and taking back) the data */
+		DataBufferAllocator* allocator;
+
 	public:
 
 		/** ctor */
-		DataBuffer() : data(0), allocatedBytes(0), usedBytes(0) {
+		DataBuffer() : data(0), allocatedBytes(0), usedBytes(0), owner(true), allocator(DataBufferAllocator::getDefault()) {
+			;
+		}
+
+		/** ctor using the given allocator instead of the default one */
+		explicit DataBuffer(DataBufferAllocator* allocator) : data(0), allocatedBytes(0), usedBytes(0), owner(true), allocator(allocator) {
 			;
 		}
 
@@ -39,8 +54,7 @@ namespace K {
 		~DataBuffer() {
 
 			// cleanup
-			delete data;
-			data = nullptr;
+			release();
 
 		}
 
@@ -48,28 +62,55 @@ namespace K {
 		void ensureSpace(const uint32_t numBytes) {
 
 			// already enough space allocated?
-			if (allocatedBytes >= numBytes) {return;}
+			if (owner && allocatedBytes >= numBytes) {return;}
 
-			// cleanup previous allocation
-			delete data;
+			// cleanup previous allocation (views never free the foreign memory)
+			release();
+			owner = true;
 
-			// allocate new buffer
-			data = (uint8_t*) malloc(numBytes);
+			// allocate new buffer (content is not preserved nor initialized)
+			data = allocator->allocate(numBytes, allocatedBytes);
 
 			// sanity check
-			if (data == nullptr) {throw new ConverterException("out of memory");}
+			if (data == nullptr) {allocatedBytes = 0; throw ConverterException("out of memory");}
 
-			// adjust
-			memset(data, 0, numBytes);
-			allocatedBytes = numBytes;
-
-			debug("DataBuffer", "allocated " << numBytes << " bytes");
+			debugVerbose("DataBuffer", "allocated " << numBytes << " bytes");
 
 		}
 
 		/** get the data pointer */
 		uint8_t* getData() const {return data;}
 
+		/** get the allocator providing the data */
+		DataBufferAllocator* getAllocator() const {return allocator;}
+
+		/** use the given allocator for all further allocations. frees the current data */
+		void setAllocator(DataBufferAllocator* allocator) {
+			release();
+			this->allocator = allocator;
+		}
+
+		/** get the memory all DataBuffers got from the system so far (see DataBufferStats) */
+		static DataBufferStats& getStats() {
+			return DataBufferAllocator::getStats();
+		}
+
+		/**
+		 * let this buffer point to foreign memory (e.g. a driver's mmap buffer) without copying.
+		 * the memory is never freed by this buffer. the next ensureSpace() replaces
+		 * the view with an own allocation.
+		 */
+		void wrap(uint8_t* foreign, const uint32_t numBytes) {
+			release();
+			data = foreign;
+			allocatedBytes = numBytes;
+			usedBytes = numBytes;
+			owner = false;
+		}
+
+		/** does this buffer only point to foreign memory? */
+		bool isView() const {return !owner;}
+
 
 		/** set the number of used bytes */
 		void setBytesUsed(const uint32_t usedBytes) {this->usedBytes = usedBytes;}
@@ -83,11 +124,39 @@ namespace K {
 			this->data = o.data;
 			this->usedBytes = o.usedBytes;
 			this->allocatedBytes = o.allocatedBytes;
+			this->owner = o.owner;
+			this->allocator = o.allocator;
 			o.data = nullptr;
+			o.allocatedBytes = 0;
+			o.usedBytes = 0;
+			o.owner = true;
+		}
+
+		/** move assignment */
+		DataBuffer& operator = (DataBuffer&& o) {
+			if (this == &o) {return *this;}
+			release();
+			this->data = o.data;
+			this->usedBytes = o.usedBytes;
+			this->allocatedBytes = o.allocatedBytes;
+			this->owner = o.owner;
+			this->allocator = o.allocator;
+			o.data = nullptr;
+			o.allocatedBytes = 0;
+			o.usedBytes = 0;
+			o.owner = true;
+			return *this;
 		}
 
 	private:
 
+		/** hand the data back to its allocator (views never free the foreign memory) */
+		void release() {
+			if (owner && data) {allocator->release(data, allocatedBytes);}
+			data = nullptr;
+			allocatedBytes = 0;
+		}
+
 		/** hidden copy ctor */
 		DataBuffer(const DataBuffer&);
 
@@ -0,0 +1,319 @@
+#ifndef K_DATABUFFERALLOCATOR_H
+#define K_DATABUFFERALLOCATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <sys/mman.h>
+
+namespace K {
+
+	/** the memory all DataBuffers got from the system (e.g. for benchmarks). memory recycled by a PoolAllocator is not counted */
+	struct DataBufferStats {
+		std::atomic<uint64_t> numAllocations;
+		std::atomic<uint64_t> numBytes;
+	};
+
+	/**
+	 * provides the memory for DataBuffers.
+	 *
+	 * all allocators return memory aligned to (at least) ALIGNMENT bytes
+	 * and do not initialize it.
+	 *
+	 * the default allocator (used by all new DataBuffers) is a PoolAllocator
+	 * on top of the AlignedAllocator. to back large buffers (e.g. 4K frames)
+	 * by huge pages, use:
+	 *	DataBufferAllocator::setDefault(new PoolAllocator(HugePageAllocator::get()));
+	 * before creating any DataBuffer (allocators must outlive all their buffers).
+	 */
+	class DataBufferAllocator {
+
+	public:
+
+		/** the min. alignment of all allocations (cache-line / AVX-512) */
+		static constexpr uint32_t ALIGNMENT = 64;
+
+		/** dtor */
+		virtual ~DataBufferAllocator() {;}
+
+		/**
+		 * allocate (uninitialized) memory for at least numBytes
+		 * @param numBytes the number of bytes needed
+		 * @param capacity receives the number of bytes actually usable (>= numBytes)
+		 * @return the memory, nullptr if out of memory
+		 */
+		virtual uint8_t* allocate(const uint32_t numBytes, uint32_t& capacity) = 0;
+
+		/**
+		 * hand back memory returned by allocate()
+		 * @param numBytes the size requested from allocate() or the capacity it returned
+		 */
+		virtual void release(uint8_t* ptr, const uint32_t numBytes) = 0;
+
+		/** get the allocator used by new DataBuffers */
+		static DataBufferAllocator* getDefault() {return getDefaultRef().load(std::memory_order_acquire);}
+
+		/** set the allocator used by new DataBuffers. existing buffers keep using their allocator */
+		static void setDefault(DataBufferAllocator* allocator) {getDefaultRef().store(allocator, std::memory_order_release);}
+
+		/** get the memory allocated from the system so far (by all allocators that do so) */
+		static DataBufferStats& getStats() {
+			static DataBufferStats stats;
+			return stats;
+		}
+
+	protected:
+
+		/** round up to a multiple of ALIGNMENT (at least ALIGNMENT) */
+		static uint64_t align(const uint64_t numBytes) {
+			return (numBytes == 0) ? (ALIGNMENT) : ((numBytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT);
+		}
+
+		/** allocators getting memory from the system count it here */
+		static void count(const uint64_t numBytes) {
+			++getStats().numAllocations;
+			getStats().numBytes += numBytes;
+		}
+
+	private:
+
+		static std::atomic<DataBufferAllocator*>& getDefaultRef();
+
+	};
+
+	/** aligned heap memory (posix_memalign) */
+	class AlignedAllocator : public DataBufferAllocator {
+
+	public:
+
+		/** get the allocator (never destroyed, thus usable by static DataBuffers) */
+		static AlignedAllocator& get() {
+			static AlignedAllocator* allocator = new AlignedAllocator();
+			return *allocator;
+		}
+
+		uint8_t* allocate(const uint32_t numBytes, uint32_t& capacity) override {
+			void* ptr;
+			if (align(numBytes) > UINT32_MAX) {return nullptr;}
+			capacity = (uint32_t) align(numBytes);
+			if (posix_memalign(&ptr, ALIGNMENT, capacity) != 0) {return nullptr;}
+			count(capacity);
+			return (uint8_t*) ptr;
+		}
+
+		void release(uint8_t* ptr, const uint32_t numBytes) override {
+			(void) numBytes;
+			free(ptr);
+		}
+
+	};
+
+	/**
+	 * huge pages for large allocations: fewer TLB misses when
+	 * processing e.g. 4K frames.
+	 *
+	 * allocations of at least minBytes are rounded up to a multiple of 2 MB and use
+	 * reserved huge pages (MAP_HUGETLB, see /proc/sys/vm/nr_hugepages) if available.
+	 * otherwise, 2 MB aligned memory is mapped and marked for transparent huge pages.
+	 * smaller allocations use the AlignedAllocator.
+	 */
+	class HugePageAllocator : public DataBufferAllocator {
+
+	public:
+
+		/** the size of one huge page */
+		static constexpr uint32_t HUGE_PAGE_SIZE = 2*1024*1024;
+
+		/**
+		 * ctor
+		 * @param minBytes the min. size of allocations to back by huge pages
+		 */
+		HugePageAllocator(const uint32_t minBytes = HUGE_PAGE_SIZE) : minBytes(minBytes) {
+			;
+		}
+
+		/** get an allocator with the default settings (never destroyed) */
+		static HugePageAllocator& get() {
+			static HugePageAllocator* allocator = new HugePageAllocator();
+			return *allocator;
+		}
+
+		uint8_t* allocate(const uint32_t numBytes, uint32_t& capacity) override {
+
+			if (isSmall(numBytes)) {return AlignedAllocator::get().allocate(numBytes, capacity);}
+			const size_t size = roundUp(numBytes);
+			if (size > UINT32_MAX) {return nullptr;}
+			capacity = (uint32_t) size;
+
+			// reserved huge pages
+			void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (ptr != MAP_FAILED) {count(size); return (uint8_t*) ptr;}
+
+			// transparent huge pages: need 2 MB aligned memory -> map more and trim
+			uint8_t* raw = (uint8_t*) mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (raw == MAP_FAILED) {return nullptr;}
+			uint8_t* aligned = (uint8_t*) (((uintptr_t) raw + HUGE_PAGE_SIZE - 1) & ~((uintptr_t) HUGE_PAGE_SIZE - 1));
+			if (aligned > raw) {munmap(raw, aligned - raw);}
+			munmap(aligned + size, (raw + size + HUGE_PAGE_SIZE) - (aligned + size));
+			#ifdef MADV_HUGEPAGE
+			madvise(aligned, size, MADV_HUGEPAGE);
+			#endif
+			count(size);
+			return aligned;
+
+		}
+
+		void release(uint8_t* ptr, const uint32_t numBytes) override {
+			if (isSmall(numBytes)) {AlignedAllocator::get().release(ptr, numBytes); return;}
+			munmap(ptr, roundUp(numBytes));
+		}
+
+	private:
+
+		/** the min. size of allocations to back by huge pages */
+		const uint32_t minBytes;
+
+		/**
+		 * use the AlignedAllocator? decided by the aligned size, which is the same
+		 * for the requested size and the capacity returned for it
+		 */
+		bool isSmall(const uint32_t numBytes) const {
+			return align(numBytes) < minBytes;
+		}
+
+		static size_t roundUp(const uint32_t numBytes) {
+			return (size_t) ((align(numBytes) + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+		}
+
+	};
+
+	/**
+	 * keeps released memory for re-use instead of returning it to the upstream allocator.
+	 *
+	 * allocations are rounded up to size-classes (4 per power of two, thus
+	 * at most 25% waste) and released memory is kept within one free-list
+	 * per class. e.g. the frames released by one stage (or thread) are
+	 * recycled by the next one requesting the same size.
+	 *
+	 * at most maxCachedBytes are kept, more is released to the upstream allocator.
+	 * thread-safe.
+	 */
+	class PoolAllocator : public DataBufferAllocator {
+
+	public:
+
+		/**
+		 * ctor
+		 * @param upstream the allocator to get new memory from. must outlive the pool
+		 * @param maxCachedBytes the max. number of (released) bytes to keep for re-use
+		 */
+		PoolAllocator(DataBufferAllocator& upstream, const uint64_t maxCachedBytes = 256*1024*1024) :
+			upstream(upstream), maxCachedBytes(maxCachedBytes), cachedBytes(0), numHits(0), numMisses(0) {
+			;
+		}
+
+		/** dtor. releases all cached memory */
+		~PoolAllocator() {
+			trim();
+		}
+
+		uint8_t* allocate(const uint32_t numBytes, uint32_t& capacity) override {
+
+			capacity = getSizeClass(numBytes);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				std::map<uint32_t, std::vector<uint8_t*>>::iterator it = freeLists.find(capacity);
+				if (it != freeLists.end() && !it->second.empty()) {
+					uint8_t* ptr = it->second.back();
+					it->second.pop_back();
+					cachedBytes -= capacity;
+					++numHits;
+					return ptr;
+				}
+				++numMisses;
+			}
+
+			uint32_t upstreamCapacity;
+			return upstream.allocate(capacity, upstreamCapacity);
+
+		}
+
+		void release(uint8_t* ptr, const uint32_t numBytes) override {
+
+			// idempotent: the capacity returned by allocate() maps to itself
+			const uint32_t sizeClass = getSizeClass(numBytes);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (cachedBytes + sizeClass <= maxCachedBytes) {
+					freeLists[sizeClass].push_back(ptr);
+					cachedBytes += sizeClass;
+					return;
+				}
+			}
+
+			upstream.release(ptr, sizeClass);
+
+		}
+
+		/** return all cached memory to the upstream allocator */
+		void trim() {
+			std::lock_guard<std::mutex> lock(mutex);
+			for (std::pair<const uint32_t, std::vector<uint8_t*>>& list : freeLists) {
+				for (uint8_t* ptr : list.second) {upstream.release(ptr, list.first);}
+			}
+			freeLists.clear();
+			cachedBytes = 0;
+		}
+
+		/** get the number of bytes currently kept for re-use */
+		uint64_t getCachedBytes() const {std::lock_guard<std::mutex> lock(mutex); return cachedBytes;}
+
+		/** get the number of allocations served from the pool */
+		uint64_t getNumHits() const {std::lock_guard<std::mutex> lock(mutex); return numHits;}
+
+		/** get the number of allocations passed to the upstream allocator */
+		uint64_t getNumMisses() const {std::lock_guard<std::mutex> lock(mutex); return numMisses;}
+
+		/** round the given size up to its size-class */
+		static uint32_t getSizeClass(const uint32_t numBytes) {
+			if (numBytes <= 4096) {return 4096;}
+			uint32_t pow2 = 4096;
+			while (pow2 <= numBytes / 2) {pow2 *= 2;}				// largest power of two <= numBytes
+			const uint64_t step = pow2 / 4;
+			const uint64_t size = ((uint64_t) numBytes + step - 1) / step * step;
+			return (size > UINT32_MAX) ? (numBytes) : ((uint32_t) size);
+		}
+
+	private:
+
+		DataBufferAllocator& upstream;
+		const uint64_t maxCachedBytes;
+
+		mutable std::mutex mutex;
+		std::map<uint32_t, std::vector<uint8_t*>> freeLists;
+		uint64_t cachedBytes;
+		uint64_t numHits;
+		uint64_t numMisses;
+
+		/** hidden copy ctor */
+		PoolAllocator(const PoolAllocator&);
+
+		/** hidden assignment operator */
+		PoolAllocator& operator = (const PoolAllocator&);
+
+	};
+
+	inline std::atomic<DataBufferAllocator*>& DataBufferAllocator::getDefaultRef() {
+		// never destroyed, thus usable by static DataBuffers
+		static std::atomic<DataBufferAllocator*> allocator(new PoolAllocator(AlignedAllocator::get()));
+		return allocator;
+	}
+
+}
+
+#endif // K_DATABUFFERALLOCATOR_H
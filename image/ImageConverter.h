@@ -13,15 +13,16 @@
 
 #include <linux/videodev2.h>
 #include <cstring>
+#include <memory>
 
-#include "converters/Yxx_RGB24.h"
-#include "converters/Yxx_Yxx.h"
-#include "converters/YUYV_RGB24.h"
-#include "converters/YUV420_RGB24.h"
-#include "converters/YUV420_YUV24.h"
+#include "ThreadPool.h"
+#include "ConversionGraph.h"
+
+#include "converters/Resize_RGB24.h"
 #include "converters/YUV.h"
 #include "converters/MJPEG_JPEG.h"
 #include "converters/JPEG.h"
+#include "converters/JPEGDecoder.h"
 #include "converters/limit.h"
 
 #define IMG_CONV_NUM_BUFFERS	2
@@ -39,6 +40,12 @@ namespace K {
 	 * -> create several ImageConverters if concurrent conversions are needed
 	 * or copy the result immediately
 	 *
+	 * setThreads() lets each conversion split the image into horizontal
+	 * stripes that are converted in parallel.
+	 *
+	 * convert() uses the cheapest chain of conversions from the ConversionGraph.
+	 * the intermediate images of such chains are kept for the next conversion.
+	 *
 	 */
 	class ImageConverter {
 
@@ -47,11 +54,80 @@ namespace K {
 		/** pre-allocated buffers that can be used to reduce mallocs */
 		WebcamImage buffers[IMG_CONV_NUM_BUFFERS];
 
+		/** the (persistent) JPEG compressor */
+		mutable JPEGEncoder jpeg;
+
+		/** the (persistent) JPEG decompressor */
+		mutable JPEGDecoder jpegDecoder;
+
+		/** decoded (M)JPEGs, before resizing */
+		mutable WebcamImage decoded;
+
+		/** the threads to use for conversions (if any) */
+		std::unique_ptr<ThreadPool> pool;
+
+		/** intermediate images for chains of conversions */
+		mutable std::vector<std::unique_ptr<WebcamImage>> intermediates;
+
 	public:
 
+		/**
+		 * use several threads for each conversion. every image is split
+		 * into horizontal stripes which are converted in parallel.
+		 * @param numThreads the number of threads to use. 0 = one per core, 1 = no threading
+		 * @param stripeHeight the number of rows per stripe. 0 = automatic
+		 */
+		void setThreads(const uint32_t numThreads, const uint32_t stripeHeight = 0) {
+			if (numThreads == 1)	{pool.reset();}
+			else					{pool.reset(new ThreadPool(numThreads, stripeHeight));}
+		}
+
+		/** get the number of threads used for each conversion */
+		uint32_t getNumThreads() const {return (pool) ? (pool->getNumThreads()) : (1);}
+
 		/** -------------------------------- OFTEN USED CONVERSIONS -------------------------------- */
 
 
+		/**
+		 * convert the given WebcamImage to the given pixel format, using the cheapest
+		 * chain of conversions (see ConversionGraph). returns src itself if it already has this format.
+		 * BEWARE! the returned webcam image is volatile and its data belongs to the converter!
+		 * @param src the input WebcamImage
+		 * @param dstFormat the pixel format to convert to (e.g. V4L2_PIX_FMT_RGB24)
+		 * @param quality the quality to use for conversions to JPEG
+		 * @return the output WebcamImage in the given format
+		 */
+		WebcamImage& convert(const WebcamImage& src, const uint32_t dstFormat, const uint8_t quality = 90) const {
+
+			const ConversionGraph::Path* path = ConversionGraph::get().getPath(src.getPixelFormat()._int, dstFormat);
+			if (!path) {throw ConverterException("no conversion to " + PixelFormat(dstFormat).asString() + " from ", src.getPixelFormat());}
+
+			ConversionContext ctx;
+			ctx.pool = pool.get();
+			ctx.jpegEncoder = &jpeg;
+			ctx.jpegDecoder = &jpegDecoder;
+			ctx.quality = quality;
+
+			// all but the last step use the intermediate images
+			while (intermediates.size() + 1 < path->size()) {intermediates.push_back(std::unique_ptr<WebcamImage>(new WebcamImage()));}
+
+			const WebcamImage* img = &src;
+			for (size_t i = 0; i < path->size(); ++i) {
+				const ConversionEdge* edge = (*path)[i];
+				WebcamImage& out = (i + 1 == path->size()) ? (getEmptyImage()) : (*intermediates[i]);
+				debugVerbose("ImageConverter", "converting " << edge->name);
+				traceScope(edge->name, src.getSequence());
+				img = &edge->convert(ctx, *img, out);
+			}
+
+			// the converted image still belongs to the same capture
+			if (img != &src) {((WebcamImage*) img)->setFrameInfo(src.getFrameInfo());}
+
+			return (WebcamImage&) *img;
+
+		}
+
+
 		/**
 		 * convert the given WebcamImage to RGB (if conversion is possible)
 		 * BEWARE! the returned webcam image is volatile and its data belongs to the converter!
@@ -62,57 +138,94 @@ namespace K {
 		 * @return the output WebcamImage in RGB format
 		 */
 		WebcamImage& getRGB(const WebcamImage& src) const {
+			return convert(src, V4L2_PIX_FMT_RGB24);
+		}
 
+		/**
+		 * convert the given WebcamImage to RGB with the given size (if conversion is possible).
+		 * resizing is done while converting, without creating a full-size RGB image.
+		 * BEWARE! the returned webcam image is volatile and its data belongs to the converter!
+		 * @param src the input WebcamImage
+		 * @param dstW the width of the output image
+		 * @param dstH the height of the output image
+		 * @return the output WebcamImage in RGB format
+		 */
+		WebcamImage& getRGB(const WebcamImage& src, const uint32_t dstW, const uint32_t dstH) const {
 			WebcamImage& dst = getEmptyImage();
-
-			// convert
-			switch (src.getPixelFormat()._int) {
-				case V4L2_PIX_FMT_YUV420:	convertYUV420toRGB24(src, dst); break;
-				case V4L2_PIX_FMT_YUYV:		convertYUYVtoRGB24(src, dst); break;
-				case V4L2_PIX_FMT_Y12:		convertYxxToRGB24(12, src, dst); break;
-				case V4L2_PIX_FMT_Y11:		convertYxxToRGB24(11, src, dst); break;
-				case V4L2_PIX_FMT_Y16:		convertYxxToRGB24(16, src, dst); break;
-				default:					throw ConverterException(src.getPixelFormat());
-			}
-
+			convertResized(src, dst, dstW, dstH);
 			return dst;
+		}
 
+		/**
+		 * decode the given (M)JPEG to planar YUV (V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_YUV422P
+		 * or V4L2_PIX_FMT_GREY, depending on the JPEG's sampling)
+		 * BEWARE! the returned webcam image is volatile and its data belongs to the converter!
+		 * @param src the input WebcamImage
+		 * @param scaleDenom decode with 1/1, 1/2, 1/4 or 1/8 of the size (skipping most of the decoding work)
+		 * @return the output WebcamImage in planar YUV format
+		 */
+		WebcamImage& getYUV(const WebcamImage& src, const uint32_t scaleDenom = 1) const {
+			WebcamImage& dst = getEmptyImage();
+			jpegDecoder.decodeYUV(src, dst, scaleDenom);
+			return dst;
 		}
 
 		/** convert a WebcamImage to JPEG */
 		WebcamImage& getJPEG(const WebcamImage& src, uint8_t quality) const {
+			return convert(src, V4L2_PIX_FMT_JPEG, quality);
+		}
 
-			// convert
-			switch (src.getPixelFormat()._int) {
+		/** convert a WebcamImage to a JPEG with the given size (resizing is done while converting to RGB) */
+		WebcamImage& getJPEG(const WebcamImage& src, uint8_t quality, const uint32_t dstW, const uint32_t dstH) const {
+			convertResized(src, (WebcamImage&) buffers[0], dstW, dstH);
+			jpeg.encode(buffers[0], (WebcamImage&) buffers[1], quality, pool.get());
+			return (WebcamImage&) buffers[1];
+		}
 
-				case V4L2_PIX_FMT_YUV420: {
-					convertYUV420toYUV24(src, (WebcamImage&) buffers[0]);
-					convertToJPEG(buffers[0], (WebcamImage&) buffers[1], quality);
-					return (WebcamImage&) buffers[1];
-				}
 
-				case V4L2_PIX_FMT_GEPJ: {
-					debug("ImageConverter", "is already a JPEG ;)");
-					return (WebcamImage&) src;
-				}
+	private:
 
-				case V4L2_PIX_FMT_MJPEG: {
-					convertMJPEGtoJPEG(src, (WebcamImage&) buffers[0]);
-					return (WebcamImage&) buffers[0];
-				}
+		/** convert to RGB with the given size */
+		void convertResized(const WebcamImage& src, WebcamImage& dst, const uint32_t dstW, const uint32_t dstH) const {
+
+			// the source is also the destination (e.g. the result of getRGB()) -> keep its data while resizing
+			if (&src == &dst) {
+				WebcamImage tmp(std::move(dst));
+				convertResized(tmp, dst, dstW, dstH);
+				return;
+			}
 
-				default: {
-					throw ConverterException(src.getPixelFormat());
-					//return nullptr;
+			switch (src.getPixelFormat()._int) {
+
+				case V4L2_PIX_FMT_YUV420:	convertYUV420toRGB24Resized(src, dst, dstW, dstH, pool.get()); break;
+				case V4L2_PIX_FMT_YUV422P:	convertYUV422PtoRGB24Resized(src, dst, dstW, dstH, pool.get()); break;
+				case V4L2_PIX_FMT_YUYV:		convertYUYVtoRGB24Resized(src, dst, dstW, dstH, pool.get()); break;
+				case V4L2_PIX_FMT_Y12:		convertYxxToRGB24Resized(12, src, dst, dstW, dstH, pool.get()); break;
+				case V4L2_PIX_FMT_Y11:		convertYxxToRGB24Resized(11, src, dst, dstW, dstH, pool.get()); break;
+				case V4L2_PIX_FMT_Y16:		convertYxxToRGB24Resized(16, src, dst, dstW, dstH, pool.get()); break;
+				case V4L2_PIX_FMT_GREY:		convertGREYtoRGB24Resized(src, dst, dstW, dstH, pool.get()); break;
+				case V4L2_PIX_FMT_RGB24:	resizeRGB24(src, dst, dstW, dstH, pool.get()); break;
+
+				case V4L2_PIX_FMT_MJPEG:
+				case V4L2_PIX_FMT_JPEG: {
+					// decode with the smallest size that is still >= the target size, then resize the rest
+					uint32_t scaleDenom = 8;
+					for (; scaleDenom > 1; scaleDenom /= 2) {
+						uint32_t sw, sh;
+						JPEGDecoder::getScaledSize(src.getWidth(), src.getHeight(), scaleDenom, sw, sh);
+						if (sw >= dstW && sh >= dstH) {break;}
+					}
+					jpegDecoder.decodeYUV(src, decoded, scaleDenom);
+					convertResized(decoded, dst, dstW, dstH);
+					break;
 				}
 
+				default:					throw ConverterException(src.getPixelFormat());
+
 			}
 
 		}
 
-
-	private:
-
 		/** get the next, empty, writeable image, using one of the internal data buffers */
 		WebcamImage& getEmptyImage() const {
 			static int idx = 0;
@@ -5,7 +5,9 @@
 
 /* some formats seem to be missing in the v4l headers.. */
 #define V4L2_PIX_FMT_GEPJ		0x4745504A
-#define V4L2_PIX_FMT_YUV24		(uint32_t)('Y'<<24|'U'<<16|'V'<<8|'3');
+#ifndef V4L2_PIX_FMT_YUV24
+#define V4L2_PIX_FMT_YUV24		v4l2_fourcc('Y', 'U', 'V', '3') /* 24  YUV-8-8-8     */
+#endif
 #define V4L2_PIX_FMT_Y11		v4l2_fourcc('Y', '1', '1', ' ') /* 11  Greyscale     */
 
 #endif
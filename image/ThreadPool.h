@@ -0,0 +1,254 @@
+#ifndef K_THREADPOOL_H
+#define K_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace K {
+
+	/**
+	 * a fixed number of worker threads to split work
+	 * (e.g. image conversions) into several tasks that run in parallel.
+	 *
+	 * the calling thread works on the tasks as well, so a pool with
+	 * N threads starts N-1 workers.
+	 *
+	 * parallelFor() calls from several threads are serialized.
+	 * calling parallelFor() from within a task is not allowed (deadlock).
+	 */
+	class ThreadPool {
+
+	public:
+
+		/**
+		 * ctor
+		 * @param numThreads the number of threads to use (including the calling one). 0 = one per core
+		 * @param stripeHeight the number of rows per stripe for forEachStripe(). 0 = automatic
+		 */
+		ThreadPool(uint32_t numThreads = 0, const uint32_t stripeHeight = 0) :
+			stripeHeight(stripeHeight), job(nullptr), numTasks(0), nextTask(0), numPending(0), numActive(0), generation(0), stopping(false) {
+
+			if (numThreads == 0) {numThreads = std::thread::hardware_concurrency();}
+			if (numThreads == 0) {numThreads = 1;}
+
+			for (uint32_t i = 1; i < numThreads; ++i) {
+				workers.push_back(std::thread(&ThreadPool::work, this));
+			}
+
+		}
+
+		/** dtor */
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wakeWorkers.notify_all();
+			for (std::thread& t : workers) {t.join();}
+		}
+
+
+		/** get the number of threads working on tasks (including the calling one) */
+		uint32_t getNumThreads() const {return (uint32_t) workers.size() + 1;}
+
+		/** get the number of rows per stripe for forEachStripe(). 0 = automatic */
+		uint32_t getStripeHeight() const {return stripeHeight;}
+
+		/** set the number of rows per stripe for forEachStripe(). 0 = automatic */
+		void setStripeHeight(const uint32_t stripeHeight) {this->stripeHeight = stripeHeight;}
+
+
+		/**
+		 * run func(0) ... func(numTasks-1) in parallel and wait for all of them to finish.
+		 * if a task throws, the (first) exception is rethrown here
+		 */
+		void parallelFor(const uint32_t numTasks, const std::function<void(uint32_t)>& func) {
+
+			if (numTasks == 0) {return;}
+
+			// nothing to parallelize
+			if (numTasks == 1 || workers.empty()) {
+				for (uint32_t i = 0; i < numTasks; ++i) {func(i);}
+				return;
+			}
+
+			std::lock_guard<std::mutex> runLock(runMutex);
+
+			// publish the job
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				this->job = &func;
+				this->numTasks = numTasks;
+				this->nextTask = 0;
+				this->numPending = numTasks;
+				this->error = nullptr;
+				++generation;
+			}
+			wakeWorkers.notify_all();
+
+			// help
+			runTasks(func, numTasks);
+
+			// wait for all tasks to finish and all workers to let go of the job
+			std::unique_lock<std::mutex> lock(mutex);
+			jobDone.wait(lock, [&] () {return numPending == 0 && numActive == 0;});
+			job = nullptr;
+
+			if (error) {
+				std::exception_ptr e = error;
+				error = nullptr;
+				std::rethrow_exception(e);
+			}
+
+		}
+
+		/**
+		 * split the rows [0, height) into stripes and call func(y0, y1) for each of them in parallel.
+		 * @param alignment stripes (except the last one) start and end on multiples of this value (e.g. 2 for YUV420)
+		 */
+		void forEachStripe(const uint32_t height, const uint32_t alignment, const std::function<void(uint32_t, uint32_t)>& func) {
+
+			const uint32_t rows = getStripeRows(height, alignment);
+			const uint32_t numStripes = (height + rows - 1) / rows;
+			parallelFor(numStripes, [&] (const uint32_t i) {
+				const uint32_t y0 = i * rows;
+				const uint32_t y1 = (y0 + rows < height) ? (y0 + rows) : (height);
+				func(y0, y1);
+			});
+
+		}
+
+		/** get the number of rows per stripe forEachStripe() uses for the given height */
+		uint32_t getStripeRows(const uint32_t height, const uint32_t alignment) const {
+
+			// automatic: a few stripes per thread, to balance the load
+			uint32_t rows = stripeHeight;
+			if (rows == 0) {rows = (height + getNumThreads() * 4 - 1) / (getNumThreads() * 4);}
+
+			// align
+			rows = (rows + alignment - 1) / alignment * alignment;
+			if (rows == 0) {rows = alignment;}
+			return rows;
+
+		}
+
+	private:
+
+		/** the worker threads' main-loop */
+		void work() {
+
+			uint64_t seen = 0;
+
+			while (true) {
+
+				const std::function<void(uint32_t)>* func;
+				uint32_t num;
+
+				// wait for a new job
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wakeWorkers.wait(lock, [&] () {return stopping || generation != seen;});
+					if (stopping) {return;}
+					seen = generation;
+					if (job == nullptr) {continue;}
+					func = job;
+					num = numTasks;
+					++numActive;
+				}
+
+				runTasks(*func, num);
+
+				// let go of the job
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					--numActive;
+				}
+				jobDone.notify_all();
+
+			}
+
+		}
+
+		/** work on the current job's tasks until none are left */
+		void runTasks(const std::function<void(uint32_t)>& func, const uint32_t num) {
+
+			uint32_t done = 0;
+
+			for (uint32_t i = nextTask++; i < num; i = nextTask++) {
+				try {
+					func(i);
+				} catch (...) {
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!error) {error = std::current_exception();}
+				}
+				++done;
+			}
+
+			if (done == 0) {return;}
+			std::lock_guard<std::mutex> lock(mutex);
+			numPending -= done;
+
+		}
+
+
+		/** the worker threads */
+		std::vector<std::thread> workers;
+
+		/** the number of rows per stripe for forEachStripe(). 0 = automatic */
+		uint32_t stripeHeight;
+
+		/** the current job (if any) */
+		const std::function<void(uint32_t)>* job;
+
+		/** the current job's number of tasks */
+		uint32_t numTasks;
+
+		/** the next task to work on */
+		std::atomic<uint32_t> nextTask;
+
+		/** the number of not-yet-finished tasks */
+		uint32_t numPending;
+
+		/** the number of workers currently holding the job */
+		uint32_t numActive;
+
+		/** incremented for each new job */
+		uint64_t generation;
+
+		/** shut down the workers? */
+		bool stopping;
+
+		/** the first error thrown by a task of the current job */
+		std::exception_ptr error;
+
+		/** protects the job's state */
+		std::mutex mutex;
+		std::condition_variable wakeWorkers;
+		std::condition_variable jobDone;
+
+		/** serializes parallelFor() */
+		std::mutex runMutex;
+
+		/** hidden copy ctor */
+		ThreadPool(const ThreadPool&);
+
+		/** hidden assignment operator */
+		ThreadPool& operator = (const ThreadPool&);
+
+	};
+
+	/** split the rows [0, height) into stripes processed by the given pool. no pool = one stripe in the calling thread */
+	static inline void forEachStripe(ThreadPool* pool, const uint32_t height, const uint32_t alignment, const std::function<void(uint32_t, uint32_t)>& func) {
+		if (pool == nullptr || pool->getNumThreads() < 2)	{func(0, height);}
+		else												{pool->forEachStripe(height, alignment, func);}
+	}
+
+}
+
+#endif // K_THREADPOOL_H
@@ -0,0 +1,49 @@
+#ifndef K_WEBCAMFRAMEINFO_H
+#define K_WEBCAMFRAMEINFO_H
+
+#include <cstdint>
+#include <linux/videodev2.h>
+
+namespace K {
+
+	/**
+	 * capture metadata of one image, as provided by the driver.
+	 *
+	 * the timestamp is the time the driver captured the image (usually
+	 * when its first/last byte arrived), the sequence number is counted
+	 * by the driver and allows detecting dropped frames.
+	 * IO methods without such information (R/W) use the time of reading
+	 * and count the sequence themselves.
+	 */
+	struct WebcamFrameInfo {
+
+		/** capture time in nanoseconds (CLOCK_MONOTONIC if isMonotonic()) */
+		uint64_t timestampNS;
+
+		/** the driver's frame counter */
+		uint32_t sequence;
+
+		/** the driver's buffer flags (V4L2_BUF_FLAG_...) */
+		uint32_t flags;
+
+		/** ctor */
+		WebcamFrameInfo() : timestampNS(0), sequence(0), flags(0) {;}
+
+		/** take the metadata from a dequeued driver buffer */
+		explicit WebcamFrameInfo(const struct v4l2_buffer& buf) :
+			timestampNS((uint64_t) buf.timestamp.tv_sec * 1000000000ull + (uint64_t) buf.timestamp.tv_usec * 1000ull),
+			sequence(buf.sequence), flags(buf.flags) {
+			;
+		}
+
+		/** did the driver flag the image as (possibly) corrupted? */
+		bool isError() const {return (flags & V4L2_BUF_FLAG_ERROR) != 0;}
+
+		/** is the timestamp based on CLOCK_MONOTONIC (and thus comparable to clock_gettime)? */
+		bool isMonotonic() const {return (flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;}
+
+	};
+
+}
+
+#endif // K_WEBCAMFRAMEINFO_H
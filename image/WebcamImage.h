@@ -4,9 +4,11 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <utility>
 #include "PixelFormat.h"
 
 #include "DataBuffer.h"
+#include "WebcamFrameInfo.h"
 
 namespace K {
 
@@ -16,6 +18,7 @@ namespace K {
 	 *		width and height
 	 *		raw data
 	 *		a pixel format to describe how the raw-data looks like
+	 *		capture metadata (timestamp, sequence number, flags)
 	 *
 	 * this is just a wrapper to annotate the raw-data
 	 * with its width,height and format.
@@ -33,7 +36,7 @@ namespace K {
 
 		/** create an empty webcam image */
 		WebcamImage() :
-			width(0), height(0), pixelFormat(0), data() {
+			width(0), height(0), pixelFormat(0), info(), data() {
 			;
 		}
 
@@ -44,7 +47,7 @@ namespace K {
 
 
 		/** reset all internal values (except data) to zero */
-		void reset() {width = 0; height = 0; pixelFormat = PixelFormat(0); data.setBytesUsed(0);}
+		void reset() {width = 0; height = 0; pixelFormat = PixelFormat(0); info = WebcamFrameInfo(); data.setBytesUsed(0);}
 
 		/** get the image's width in pixels */
 		uint32_t getWidth() const {return width;}
@@ -61,6 +64,18 @@ namespace K {
 		/** get the image's data */
 		uint8_t* getData() const {return data.getData();}
 
+		/** get the image's capture metadata */
+		const WebcamFrameInfo& getFrameInfo() const {return info;}
+
+		/** get the image's capture time in nanoseconds (see WebcamFrameInfo) */
+		uint64_t getTimestampNS() const {return info.timestampNS;}
+
+		/** get the driver's sequence number for this image */
+		uint32_t getSequence() const {return info.sequence;}
+
+		/** did the driver flag this image as (possibly) corrupted? */
+		bool isError() const {return info.isError();}
+
 
 		/** set the image's size in bytes */
 		void setNumBytes(const uint32_t numBytes) {data.setBytesUsed(numBytes);}
@@ -74,6 +89,9 @@ namespace K {
 		/** set the image's format (e.g. V4L2_PIX_FMT_MJPEG, V4L2_PIX_FMT_YUYV, ...) */
 		void setPixelFormat(const PixelFormat pixelFormat) {this->pixelFormat = pixelFormat;}
 
+		/** set the image's capture metadata (e.g. when converting it) */
+		void setFrameInfo(const WebcamFrameInfo& info) {this->info = info;}
+
 
 		/** set several parameters at once */
 		void setParameters(const uint32_t width, const uint32_t height, const PixelFormat pixelFormat, const uint32_t usedBytes) {
@@ -87,12 +105,25 @@ namespace K {
 			data.ensureSpace(numBytes);
 		}
 
+		/** let the image point to foreign memory without copying it (see DataBuffer::wrap()) */
+		void wrap(uint8_t* foreign, const uint32_t numBytes) {
+			data.wrap(foreign, numBytes);
+		}
+
 		/** move ctor */
-		WebcamImage(WebcamImage&& o) {
+		WebcamImage(WebcamImage&& o) :
+			width(o.width), height(o.height), pixelFormat(o.pixelFormat), info(o.info), data(std::move(o.data)) {
+			;
+		}
+
+		/** move assignment */
+		WebcamImage& operator = (WebcamImage&& o) {
 			this->data = std::move(o.data);
 			this->width = o.width;
 			this->height = o.height;
 			this->pixelFormat = o.pixelFormat;
+			this->info = o.info;
+			return *this;
 		}
 
 	private:
@@ -104,6 +135,8 @@ namespace K {
 	private:
 
 		friend class Webcam;
+		friend class WebcamFrameLease;
+		friend class WebcamRecording;
 
 		/** the image's width */
 		uint32_t width;
@@ -114,6 +147,9 @@ namespace K {
 		/** the image's pixel format */
 		PixelFormat pixelFormat;
 
+		/** the image's capture metadata */
+		WebcamFrameInfo info;
+
 
 		/** internal data storage */
 		DataBuffer data;
@@ -0,0 +1,281 @@
+#ifndef K_JPEGDECODER_H
+#define K_JPEGDECODER_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <jerror.h>
+#include <jpeglib.h>
+
+#include "../PixelFormat.h"
+#include "../../Debug.h"
+#include "../ConverterException.h"
+#include "../WebcamImage.h"
+#include "JPEGError.h"
+#include "MJPEG_JPEG.h"
+
+// the scaled DCT size was split into h/v with libjpeg 7
+#if JPEG_LIB_VERSION >= 70
+	#define K_JPEG_MIN_DCT_SIZE(cinfo)	((cinfo).min_DCT_v_scaled_size)
+	#define K_JPEG_DCT_SIZE(comp)		((comp).DCT_v_scaled_size)
+#else
+	#define K_JPEG_MIN_DCT_SIZE(cinfo)	((cinfo).min_DCT_scaled_size)
+	#define K_JPEG_DCT_SIZE(comp)		((comp).DCT_scaled_size)
+#endif
+
+namespace K {
+
+	static void jpegSourceDummy (j_decompress_ptr cinfo) {
+		(void) cinfo;
+	}
+
+	/** the whole image is within memory. reaching its end means the data is truncated -> insert an EOI */
+	static boolean jpegSourceFill (j_decompress_ptr cinfo) {
+		static const JOCTET eoi[2] = {0xFF, JPEG_EOI};
+		WARNMS(cinfo, JWRN_JPEG_EOF);
+		cinfo->src->next_input_byte = eoi;
+		cinfo->src->bytes_in_buffer = 2;
+		return TRUE;
+	}
+
+	static void jpegSourceSkip (j_decompress_ptr cinfo, long numBytes) {
+		if (numBytes <= 0) {return;}
+		if ((size_t) numBytes > cinfo->src->bytes_in_buffer) {jpegSourceFill(cinfo); return;}
+		cinfo->src->next_input_byte += numBytes;
+		cinfo->src->bytes_in_buffer -= numBytes;
+	}
+
+	/**
+	 * JPEG / MJPEG decoder that keeps the decompressor (and its source manager)
+	 * across images.
+	 *
+	 * MJPEG images missing the huffman-table are completed using getMJPEGasJPEG().
+	 *
+	 * the image can be decoded to
+	 *		RGB24
+	 *		planar YUV using libjpeg's raw-data interface (no upsampling, no color conversion).
+	 *		depending on the JPEG's sampling, this is V4L2_PIX_FMT_YUV420 (4:2:0),
+	 *		V4L2_PIX_FMT_YUV422P (4:2:2) or V4L2_PIX_FMT_GREY
+	 *
+	 * both support downscaling by 1/2, 1/4 and 1/8 within the IDCT,
+	 * which skips most of the decoding work.
+	 *
+	 * not thread-safe. use one decoder per thread.
+	 */
+	class JPEGDecoder {
+
+	public:
+
+		/** ctor */
+		JPEGDecoder() : fast(false) {
+
+			cinfo.err = jpeg_std_error (&jerr);
+			jerr.error_exit = jpegErrorExit;
+			jpeg_create_decompress (&cinfo);
+
+			jsrc.init_source = jpegSourceDummy;
+			jsrc.fill_input_buffer = jpegSourceFill;
+			jsrc.skip_input_data = jpegSourceSkip;
+			jsrc.resync_to_restart = jpeg_resync_to_restart;
+			jsrc.term_source = jpegSourceDummy;
+			cinfo.src = &jsrc;
+
+		}
+
+		/** dtor */
+		~JPEGDecoder() {
+			jpeg_destroy_decompress (&cinfo);
+		}
+
+		/** faster but less accurate decoding (integer IDCT, no fancy upsampling) */
+		void setFast(const bool fast) {this->fast = fast;}
+
+		/** get the size of the given image when decoded using the given scale-denominator (1, 2, 4, 8) */
+		static void getScaledSize(const uint32_t w, const uint32_t h, const uint32_t scaleDenom, uint32_t& sw, uint32_t& sh) {
+			sw = (w + scaleDenom - 1) / scaleDenom;
+			sh = (h + scaleDenom - 1) / scaleDenom;
+		}
+
+		/**
+		 * decode the given JPEG / MJPEG to RGB24
+		 * @param scaleDenom downscale by 1/1, 1/2, 1/4 or 1/8
+		 */
+		void decodeRGB(const WebcamImage& src, WebcamImage& dst, const uint32_t scaleDenom = 1) {
+
+			debugVerbose("JPEGDecoder", "decoding JPEG -> RGB24 (1/" << scaleDenom << ")");
+			traceScope("decode.jpeg", src.getSequence());
+
+			try {
+
+				begin(src, scaleDenom);
+				cinfo.out_color_space = JCS_RGB;
+				jpeg_start_decompress (&cinfo);
+
+				const uint32_t w = cinfo.output_width;
+				const uint32_t h = cinfo.output_height;
+				dst.ensureSpace(w*h*3);
+				uint8_t* dstBuffer = dst.getData();
+
+				// decode several scanlines at once
+				JSAMPROW rows[16];
+				while (cinfo.output_scanline < h) {
+					const uint32_t y0 = cinfo.output_scanline;
+					const uint32_t num = (h - y0 < 16) ? (h - y0) : (16);
+					for (uint32_t i = 0; i < num; ++i) {rows[i] = dstBuffer + (y0+i)*w*3;}
+					jpeg_read_scanlines (&cinfo, rows, num);
+				}
+
+				jpeg_finish_decompress (&cinfo);
+				dst.setParameters( w, h, PixelFormat(V4L2_PIX_FMT_RGB24), (w*h*3) );
+
+			} catch (...) {
+				jpeg_abort_decompress (&cinfo);
+				throw;
+			}
+
+		}
+
+		/**
+		 * decode the given JPEG / MJPEG to planar YUV (see class description)
+		 * @param scaleDenom downscale by 1/1, 1/2, 1/4 or 1/8
+		 */
+		void decodeYUV(const WebcamImage& src, WebcamImage& dst, const uint32_t scaleDenom = 1) {
+
+			debugVerbose("JPEGDecoder", "decoding JPEG -> planar YUV (1/" << scaleDenom << ")");
+			traceScope("decode.jpeg", src.getSequence());
+
+			try {
+
+				begin(src, scaleDenom);
+
+				// the output format depends on the sampling
+				const PixelFormat fmt = getPlanarFormat();
+				cinfo.raw_data_out = TRUE;
+				jpeg_start_decompress (&cinfo);
+
+				const int numComps = cinfo.num_components;
+				const uint32_t w = cinfo.output_width;
+				const uint32_t h = cinfo.output_height;
+
+				// the size of each plane and the rows (padded to whole blocks) decoded at once
+				uint32_t planeW[3], planeH[3], rowsW[3], numRows[3];
+				JSAMPROW rows[3][2*DCTSIZE];
+				JSAMPARRAY planes[3] = {rows[0], rows[1], rows[2]};
+				uint32_t total = 0;
+				uint32_t scratchSize = 0;
+				for (int c = 0; c < numComps; ++c) {
+					const jpeg_component_info& comp = cinfo.comp_info[c];
+					planeW[c] = (c == 0) ? (w) : (comp.downsampled_width);
+					planeH[c] = (c == 0) ? (h) : (comp.downsampled_height);
+					rowsW[c] = comp.width_in_blocks * K_JPEG_DCT_SIZE(comp);
+					numRows[c] = comp.v_samp_factor * K_JPEG_DCT_SIZE(comp);
+					total += planeW[c] * planeH[c];
+					scratchSize += rowsW[c] * numRows[c];
+				}
+
+				scratch.resize(scratchSize);
+				uint8_t* ptr = scratch.data();
+				for (int c = 0; c < numComps; ++c) {
+					for (uint32_t i = 0; i < numRows[c]; ++i) {rows[c][i] = ptr; ptr += rowsW[c];}
+				}
+
+				dst.ensureSpace(total);
+				uint8_t* plane[3] = {dst.getData(), nullptr, nullptr};
+				if (numComps == 3) {
+					plane[1] = plane[0] + planeW[0]*planeH[0];
+					plane[2] = plane[1] + planeW[1]*planeH[1];
+				}
+
+				// decode one iMCU-row at a time and copy the valid part into the planes
+				const uint32_t lumaRows = cinfo.max_v_samp_factor * K_JPEG_MIN_DCT_SIZE(cinfo);
+				while (cinfo.output_scanline < h) {
+					const uint32_t iMCU = cinfo.output_scanline / lumaRows;
+					jpeg_read_raw_data (&cinfo, planes, lumaRows);
+					for (int c = 0; c < numComps; ++c) {
+						for (uint32_t i = 0; i < numRows[c]; ++i) {
+							const uint32_t y = iMCU * numRows[c] + i;
+							if (y >= planeH[c]) {break;}
+							memcpy(plane[c] + y*planeW[c], rows[c][i], planeW[c]);
+						}
+					}
+				}
+
+				jpeg_finish_decompress (&cinfo);
+				dst.setParameters( w, h, fmt, total );
+
+			} catch (...) {
+				jpeg_abort_decompress (&cinfo);
+				throw;
+			}
+
+		}
+
+	private:
+
+		/** complete MJPEGs, set the source and read the header */
+		void begin(const WebcamImage& src, const uint32_t scaleDenom) {
+
+			if (scaleDenom != 1 && scaleDenom != 2 && scaleDenom != 4 && scaleDenom != 8) {
+				throw ConverterException("jpeg decoder: scaling must be 1/1, 1/2, 1/4 or 1/8");
+			}
+
+			const WebcamImage* jpeg = &src;
+			switch (src.getPixelFormat()._int) {
+				case V4L2_PIX_FMT_MJPEG:	jpeg = &getMJPEGasJPEG(src, withDHT); break;
+				case V4L2_PIX_FMT_JPEG:		break;
+				default: throw ConverterException("jpeg decoder does not support this input format", src.getPixelFormat());
+			}
+
+			jsrc.next_input_byte = jpeg->getData();
+			jsrc.bytes_in_buffer = jpeg->getNumBytes();
+			jpeg_read_header (&cinfo, TRUE);
+
+			cinfo.scale_num = 1;
+			cinfo.scale_denom = scaleDenom;
+			cinfo.dct_method = (fast) ? (JDCT_IFAST) : (JDCT_ISLOW);
+			cinfo.do_fancy_upsampling = (fast) ? (FALSE) : (TRUE);
+
+		}
+
+		/** get the planar format matching the JPEG's sampling */
+		PixelFormat getPlanarFormat() const {
+
+			if (cinfo.num_components == 1) {return PixelFormat(V4L2_PIX_FMT_GREY);}
+
+			const jpeg_component_info* c = cinfo.comp_info;
+			const bool chroma1x1 = c[1].h_samp_factor == 1 && c[1].v_samp_factor == 1 && c[2].h_samp_factor == 1 && c[2].v_samp_factor == 1;
+			if (cinfo.num_components == 3 && chroma1x1 && c[0].h_samp_factor == 2 && c[0].v_samp_factor == 2) {return PixelFormat(V4L2_PIX_FMT_YUV420);}
+			if (cinfo.num_components == 3 && chroma1x1 && c[0].h_samp_factor == 2 && c[0].v_samp_factor == 1) {return PixelFormat(V4L2_PIX_FMT_YUV422P);}
+
+			throw ConverterException("jpeg decoder: unsupported sampling for planar output");
+
+		}
+
+
+		/** the decompressor */
+		struct jpeg_decompress_struct cinfo;
+		struct jpeg_error_mgr jerr;
+		struct jpeg_source_mgr jsrc;
+
+		/** use the fast IDCT and upsampling? */
+		bool fast;
+
+		/** MJPEGs completed with the huffman-table */
+		WebcamImage withDHT;
+
+		/** one iMCU-row of each component (raw output) */
+		std::vector<uint8_t> scratch;
+
+		/** hidden copy ctor */
+		JPEGDecoder(const JPEGDecoder&);
+
+		/** hidden assignment operator */
+		JPEGDecoder& operator = (const JPEGDecoder&);
+
+	};
+
+}
+
+#endif // K_JPEGDECODER_H
@@ -0,0 +1,519 @@
+#ifndef K_JPEGENCODER_H
+#define K_JPEGENCODER_H
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <jerror.h>
+#include <jpeglib.h>
+
+#ifdef K_USE_TURBOJPEG
+	#include <turbojpeg.h>
+#endif
+
+#include "../PixelFormat.h"
+#include "../../Debug.h"
+#include "../ConverterException.h"
+#include "../WebcamImage.h"
+#include "../ThreadPool.h"
+#include "JPEGError.h"
+#include "JPEGMarkers.h"
+
+namespace K {
+
+	static boolean jpegBufferOverflow (j_compress_ptr cinfo) {
+		(void) cinfo;
+		throw ConverterException("jpeg compressor: out of memory");
+	}
+
+	static void jpegDummy (j_compress_ptr cinfo) {
+		(void) cinfo;
+	}
+
+	/**
+	 * JPEG encoder that keeps the compressor (allocations, quantization- and
+	 * huffman-tables, destination manager) across images.
+	 *
+	 * the compressor is only reconfigured when the image's size,
+	 * its pixel format or the quality change.
+	 *
+	 * supported inputs:
+	 *		V4L2_PIX_FMT_RGB24, V4L2_PIX_FMT_GREY
+	 *		V4L2_PIX_FMT_YUV420 (planar, encoded as 4:2:0 without color conversion)
+	 *		V4L2_PIX_FMT_YUYV (encoded as 4:2:2 without color conversion)
+	 *
+	 * define K_USE_TURBOJPEG (and link against libturbojpeg) to use
+	 * the TurboJPEG API for RGB24, GREY and YUV420 input.
+	 *
+	 * given a thread-pool, horizontal strips (whole MCU-rows) of the image are
+	 * encoded in parallel by one compressor each, using a restart-interval of
+	 * exactly one strip. the strips' entropy-coded data is then joined using
+	 * RSTn markers, which results in one baseline JPEG.
+	 *
+	 * not thread-safe. use one encoder per thread.
+	 */
+	class JPEGEncoder {
+
+	public:
+
+		/** ctor */
+		JPEGEncoder() : input(Input::NONE), width(0), height(0), quality(0), restartInterval(0) {
+
+			cinfo.err = jpeg_std_error (&jerr);
+			jerr.error_exit = jpegErrorExit;
+			jpeg_create_compress (&cinfo);
+
+			jdest.init_destination = jpegDummy;
+			jdest.empty_output_buffer = jpegBufferOverflow;
+			jdest.term_destination = jpegDummy;
+			cinfo.dest = &jdest;
+
+			#ifdef K_USE_TURBOJPEG
+			tj = tjInitCompress();
+			if (!tj) {throw ConverterException("turbojpeg: could not create the compressor");}
+			#endif
+
+		}
+
+		/** dtor */
+		~JPEGEncoder() {
+			jpeg_destroy_compress (&cinfo);
+			#ifdef K_USE_TURBOJPEG
+			tjDestroy(tj);
+			#endif
+		}
+
+		/**
+		 * encode the given image (see supported inputs).
+		 * the optional pool encodes several strips of the image in parallel
+		 */
+		void encode(const WebcamImage& src, WebcamImage& dst, const uint8_t quality, ThreadPool* pool = nullptr) {
+
+			traceScope("encode.jpeg", src.getSequence());
+
+			Input input;
+			switch (src.getPixelFormat()._int) {
+				case V4L2_PIX_FMT_RGB24:	input = Input::RGB; break;
+				case V4L2_PIX_FMT_GREY:		input = Input::GREY; break;
+				case V4L2_PIX_FMT_YUV420:	input = Input::RAW420; break;
+				case V4L2_PIX_FMT_YUYV:		input = Input::RAW422; break;
+				default: throw ConverterException("jpeg does not support this input format", src.getPixelFormat());
+			}
+
+			// YUYV stores one Cb/Cr pair per 2 pixels
+			if (input == Input::RAW422 && src.getWidth() < 2) {throw ConverterException("jpeg needs YUYV images to be at least 2 pixels wide", src.getPixelFormat());}
+
+			if (pool && pool->getNumThreads() > 1 && encodeParallel(src, dst, quality, input, *pool)) {return;}
+
+			#ifdef K_USE_TURBOJPEG
+			if (encodeTurbo(src, dst, quality)) {return;}
+			#endif
+
+			encodeRows(src, dst, quality, input, 0, src.getHeight(), 0);
+
+		}
+
+		/** encode interleaved YCbCr data (3 bytes per pixel), independent of the image's pixel format */
+		void encodeYCbCr(const WebcamImage& src, WebcamImage& dst, const uint8_t quality, ThreadPool* pool = nullptr) {
+			traceScope("encode.jpeg", src.getSequence());
+			if (pool && pool->getNumThreads() > 1 && encodeParallel(src, dst, quality, Input::YCBCR, *pool)) {return;}
+			encodeRows(src, dst, quality, Input::YCBCR, 0, src.getHeight(), 0);
+		}
+
+	private:
+
+		/** the kind of input the compressor is configured for */
+		enum class Input {
+			NONE,
+			RGB,
+			GREY,
+			YCBCR,
+			RAW420,
+			RAW422,
+		};
+
+		/** (re)configure the compressor, if anything changed since the last image */
+		void configure(const Input input, const uint32_t width, const uint32_t height, const uint8_t quality, const uint32_t restartInterval) {
+
+			if (input == this->input && width == this->width && height == this->height && quality == this->quality && restartInterval == this->restartInterval) {return;}
+
+			debug("JPEGEncoder", "configuring for " << width << "x" << height << " @ " << (int) quality);
+
+			// set image-information (width/height) and output parameters (quality)
+			cinfo.image_width = width;
+			cinfo.image_height = height;
+			cinfo.input_components = (input == Input::GREY) ? (1) : (3);
+			cinfo.in_color_space = (input == Input::GREY) ? (JCS_GRAYSCALE) : ((input == Input::RGB) ? (JCS_RGB) : (JCS_YCbCr));
+			jpeg_set_defaults (&cinfo);
+			jpeg_set_quality (&cinfo, quality, TRUE);
+			cinfo.restart_interval = restartInterval;
+
+			// planar input is provided as it is (no color conversion, no downsampling)
+			if (input == Input::RAW420 || input == Input::RAW422) {
+				jpeg_set_colorspace (&cinfo, JCS_YCbCr);
+				cinfo.raw_data_in = TRUE;
+				cinfo.comp_info[0].h_samp_factor = 2;
+				cinfo.comp_info[0].v_samp_factor = (input == Input::RAW420) ? (2) : (1);
+				cinfo.comp_info[1].h_samp_factor = 1;
+				cinfo.comp_info[1].v_samp_factor = 1;
+				cinfo.comp_info[2].h_samp_factor = 1;
+				cinfo.comp_info[2].v_samp_factor = 1;
+			}
+
+			this->input = input;
+			this->width = width;
+			this->height = height;
+			this->quality = quality;
+			this->restartInterval = restartInterval;
+
+		}
+
+		/** get the size of one MCU and the number of 8x8 blocks it contains (the default sampling for RGB / YCbCr is 4:2:0) */
+		static void getMCU(const Input input, uint32_t& mcuW, uint32_t& mcuH, uint32_t& numBlocks) {
+			mcuW = (input == Input::GREY) ? (8) : (16);
+			mcuH = (input == Input::GREY || input == Input::RAW422) ? (8) : (16);
+			numBlocks = (input == Input::GREY) ? (1) : ((input == Input::RAW422) ? (4) : (6));
+		}
+
+		/** start compressing into dst */
+		void begin(WebcamImage& dst, const Input input, const uint32_t w, const uint32_t h) {
+
+			// worst case (e.g. noise at quality 100): 2 bytes per sample of the MCU-padded image (like TurboJPEG's tjBufSize).
+			// plus some space for the headers of very small images
+			uint32_t mcuW, mcuH, numBlocks;
+			getMCU(input, mcuW, mcuH, numBlocks);
+			const uint32_t numMCUs = ((w + mcuW - 1) / mcuW) * ((h + mcuH - 1) / mcuH);
+			maxSize = numMCUs * numBlocks * 64 * 2 + 2048;
+			dst.ensureSpace(maxSize);
+			jdest.next_output_byte = dst.getData();
+			jdest.free_in_buffer = maxSize;
+
+			jpeg_start_compress (&cinfo, TRUE);
+
+		}
+
+		/** finish compressing into dst */
+		void finish(WebcamImage& dst, const uint32_t w, const uint32_t h) {
+			jpeg_finish_compress (&cinfo);
+			dst.setParameters( w, h, PixelFormat(V4L2_PIX_FMT_JPEG), (maxSize - jdest.free_in_buffer) );
+		}
+
+		/** reset the compressor after an error. the configuration is kept */
+		void abort() {
+			jpeg_abort_compress (&cinfo);
+		}
+
+		/** encode the rows [y0, y1) of the given image as a JPEG of its own */
+		void encodeRows(const WebcamImage& src, WebcamImage& dst, const uint8_t quality, const Input input, const uint32_t y0, const uint32_t y1, const uint32_t restartInterval) {
+			switch (input) {
+				case Input::RAW420:
+				case Input::RAW422:		encodeRaw(src, dst, quality, input, y0, y1, restartInterval); break;
+				default:				encodeScanlines(src, dst, quality, input, y0, y1, restartInterval); break;
+			}
+		}
+
+		/** encode interleaved input (RGB24, GREY, YCbCr) one scanline at a time */
+		void encodeScanlines(const WebcamImage& src, WebcamImage& dst, const uint8_t quality, const Input input, const uint32_t y0, const uint32_t y1, const uint32_t restartInterval) {
+
+			debugVerbose("JPEGEncoder", "converting to JPEG");
+
+			const uint32_t w = src.getWidth();
+			const uint32_t h = y1 - y0;
+			const uint32_t numComponents = (input == Input::GREY) ? (1) : (3);
+			const uint32_t stride = w * numComponents;
+			const uint8_t* srcBuffer = src.getData() + y0 * stride;
+
+			configure(input, w, h, quality, restartInterval);
+
+			try {
+
+				begin(dst, input, w, h);
+
+				// compress each scanline
+				while (cinfo.next_scanline < h) {
+					JSAMPROW row = (JSAMPROW)(srcBuffer + cinfo.next_scanline * stride);
+					jpeg_write_scanlines (&cinfo, &row, 1);
+				}
+
+				finish(dst, w, h);
+
+			} catch (...) {
+				abort();
+				throw;
+			}
+
+		}
+
+		/** encode planar input using libjpeg's raw-data interface, one MCU-row at a time */
+		void encodeRaw(const WebcamImage& src, WebcamImage& dst, const uint8_t quality, const Input input, const uint32_t y0, const uint32_t y1, const uint32_t restartInterval) {
+
+			debugVerbose("JPEGEncoder", "converting to JPEG (raw)");
+
+			const uint32_t w = src.getWidth();
+			const uint32_t h = y1 - y0;
+
+			configure(input, w, h, quality, restartInterval);
+
+			// rows must be a multiple of the MCU's width (16)
+			padW = (w + 15) / 16 * 16;
+			padCW = padW / 2;
+
+			JSAMPROW yRows[2*DCTSIZE];
+			JSAMPROW uRows[DCTSIZE];
+			JSAMPROW vRows[DCTSIZE];
+			JSAMPARRAY planes[3] = {yRows, uRows, vRows};
+			const uint32_t numRows = (input == Input::RAW420) ? (2*DCTSIZE) : (DCTSIZE);
+
+			try {
+
+				begin(dst, input, w, h);
+
+				while (cinfo.next_scanline < h) {
+					if (input == Input::RAW420)	{getRowsYUV420(src, y0 + cinfo.next_scanline, yRows, uRows, vRows);}
+					else						{getRowsYUYV(src, y0 + cinfo.next_scanline, yRows, uRows, vRows);}
+					jpeg_write_raw_data (&cinfo, planes, numRows);
+				}
+
+				finish(dst, w, h);
+
+			} catch (...) {
+				abort();
+				throw;
+			}
+
+		}
+
+		/**
+		 * encode strips of whole MCU-rows in parallel and join them into one JPEG.
+		 * returns false if the image is too small to be split
+		 */
+		bool encodeParallel(const WebcamImage& src, WebcamImage& dst, const uint8_t quality, const Input input, ThreadPool& pool) {
+
+			const uint32_t w = src.getWidth();
+			const uint32_t h = src.getHeight();
+
+			uint32_t mcuW, mcuH, numBlocks;
+			getMCU(input, mcuW, mcuH, numBlocks);
+			const uint32_t mcusPerRow = (w + mcuW - 1) / mcuW;
+
+			// the restart-interval (= MCUs per strip) is limited to 16 bit
+			const uint32_t maxRows = 65535 / mcusPerRow * mcuH;
+			uint32_t rows = pool.getStripeRows(h, mcuH);
+			if (rows > maxRows) {rows = maxRows;}
+			if (rows == 0 || rows >= h) {return false;}
+
+			const uint32_t numStrips = (h + rows - 1) / rows;
+			const uint32_t restartInterval = rows / mcuH * mcusPerRow;
+
+			debugVerbose("JPEGEncoder", "converting to JPEG using " << numStrips << " strips");
+
+			while (strips.size() < numStrips) {strips.push_back(std::unique_ptr<Strip>(new Strip()));}
+
+			pool.parallelFor(numStrips, [&] (const uint32_t i) {
+				const uint32_t y0 = i * rows;
+				const uint32_t y1 = (y0 + rows < h) ? (y0 + rows) : (h);
+				Strip& strip = *strips[i];
+				strip.enc->encodeRows(src, strip.jpeg, quality, input, y0, y1, restartInterval);
+				if (!parseJPEGSegments(strip.jpeg.getData(), strip.jpeg.getNumBytes(), strip.seg) || strip.seg.dri < 0) {
+					throw ConverterException("jpeg compressor: invalid strip");
+				}
+			});
+
+			// headers of the first strip, the entropy-coded data (without EOI) of all strips, separated by RSTn
+			const JPEGSegments& seg = strips[0]->seg;
+			uint32_t size = seg.scan + 2;
+			for (uint32_t i = 0; i < numStrips; ++i) {size += strips[i]->jpeg.getNumBytes() - 2 - strips[i]->seg.scan + ((i > 0) ? (2) : (0));}
+
+			dst.ensureSpace(size);
+			uint8_t* ptr = dst.getData();
+			memcpy(ptr, strips[0]->jpeg.getData(), seg.scan);
+
+			// the SOF contains the first strip's height: FF Cx [length:2] [precision:1] [height:2]
+			ptr[seg.sof + 5] = (uint8_t) (h >> 8);
+			ptr[seg.sof + 6] = (uint8_t) (h >> 0);
+			ptr += seg.scan;
+
+			for (uint32_t i = 0; i < numStrips; ++i) {
+				const Strip& strip = *strips[i];
+				const uint32_t len = strip.jpeg.getNumBytes() - 2 - strip.seg.scan;
+				if (i > 0) {*ptr++ = 0xFF; *ptr++ = (uint8_t) (JPEG_MARKER_RST0 + ((i-1) & 7));}
+				memcpy(ptr, strip.jpeg.getData() + strip.seg.scan, len);
+				ptr += len;
+			}
+
+			*ptr++ = 0xFF;
+			*ptr++ = JPEG_MARKER_EOI;
+
+			dst.setParameters( w, h, PixelFormat(V4L2_PIX_FMT_JPEG), size );
+			return true;
+
+		}
+
+		/** copy a row of n samples into a row of padded samples, repeating the last one */
+		static inline void padRow(const uint8_t* src, uint8_t* dst, const uint32_t n, const uint32_t padded) {
+			memcpy(dst, src, n);
+			memset(dst + n, src[n-1], padded - n);
+		}
+
+		/** get 16 luma and 8 chroma rows starting at luma row y0. points into the image if no padding is needed */
+		void getRowsYUV420(const WebcamImage& src, const uint32_t y0, JSAMPROW* yRows, JSAMPROW* uRows, JSAMPROW* vRows) {
+
+			const uint32_t w = src.getWidth();
+			const uint32_t h = src.getHeight();
+			const uint32_t cw = (w+1) / 2;
+			const uint32_t ch = (h+1) / 2;
+
+			const uint8_t* srcY = src.getData();
+			const uint8_t* srcU = srcY + w*h;
+			const uint8_t* srcV = srcU + cw*ch;
+
+			const bool pad = (padW != w);
+			if (pad) {rows.resize(16*padW + 2*8*padCW);}
+
+			// rows beyond the image's height repeat the last one
+			for (uint32_t i = 0; i < 16; ++i) {
+				const uint32_t y = (y0 + i < h) ? (y0 + i) : (h - 1);
+				yRows[i] = (JSAMPROW) (srcY + y*w);
+				if (pad) {padRow(yRows[i], &rows[i*padW], w, padW); yRows[i] = &rows[i*padW];}
+			}
+
+			for (uint32_t i = 0; i < 8; ++i) {
+				const uint32_t y = (y0/2 + i < ch) ? (y0/2 + i) : (ch - 1);
+				uRows[i] = (JSAMPROW) (srcU + y*cw);
+				vRows[i] = (JSAMPROW) (srcV + y*cw);
+				if (pad) {
+					uint8_t* padU = &rows[16*padW + i*padCW];
+					uint8_t* padV = &rows[16*padW + (8+i)*padCW];
+					padRow(uRows[i], padU, cw, padCW); uRows[i] = padU;
+					padRow(vRows[i], padV, cw, padCW); vRows[i] = padV;
+				}
+			}
+
+		}
+
+		/** de-interleave 8 YUYV rows starting at row y0 into padded planes */
+		void getRowsYUYV(const WebcamImage& src, const uint32_t y0, JSAMPROW* yRows, JSAMPROW* uRows, JSAMPROW* vRows) {
+
+			const uint32_t w = src.getWidth();
+			const uint32_t h = src.getHeight();
+			const uint32_t cw = w / 2;
+
+			rows.resize(8*padW + 2*8*padCW);
+
+			for (uint32_t i = 0; i < 8; ++i) {
+
+				// rows beyond the image's height repeat the last one
+				const uint32_t y = (y0 + i < h) ? (y0 + i) : (h - 1);
+				const uint8_t* row = src.getData() + y*w*2;
+				uint8_t* dy = yRows[i] = &rows[i*padW];
+				uint8_t* du = uRows[i] = &rows[8*padW + i*padCW];
+				uint8_t* dv = vRows[i] = &rows[8*padW + (8+i)*padCW];
+
+				for (uint32_t x = 0; x < cw; ++x) {
+					dy[x*2+0] = row[x*4+0];
+					du[x] = row[x*4+1];
+					dy[x*2+1] = row[x*4+2];
+					dv[x] = row[x*4+3];
+				}
+
+				memset(dy + cw*2, dy[cw*2-1], padW - cw*2);
+				memset(du + cw, du[cw-1], padCW - cw);
+				memset(dv + cw, dv[cw-1], padCW - cw);
+
+			}
+
+		}
+
+		#ifdef K_USE_TURBOJPEG
+		/** encode using TurboJPEG. returns false if the input is not supported */
+		bool encodeTurbo(const WebcamImage& src, WebcamImage& dst, const uint8_t quality) {
+
+			const int w = src.getWidth();
+			const int h = src.getHeight();
+			int subsamp;
+
+			switch (src.getPixelFormat()._int) {
+				case V4L2_PIX_FMT_RGB24:	subsamp = TJSAMP_420; break;
+				case V4L2_PIX_FMT_GREY:		subsamp = TJSAMP_GRAY; break;
+				case V4L2_PIX_FMT_YUV420:	subsamp = TJSAMP_420; break;
+				default:					return false;
+			}
+
+			debugVerbose("JPEGEncoder", "converting to JPEG (turbo)");
+
+			// compress directly into dst
+			unsigned long size = tjBufSize(w, h, subsamp);
+			dst.ensureSpace(size);
+			unsigned char* buf = dst.getData();
+
+			int res;
+			if (src.getPixelFormat()._int == V4L2_PIX_FMT_YUV420) {
+				const int cw = (w+1) / 2;
+				const int ch = (h+1) / 2;
+				const unsigned char* planes[3] = {src.getData(), src.getData() + w*h, src.getData() + w*h + cw*ch};
+				const int strides[3] = {w, cw, cw};
+				res = tjCompressFromYUVPlanes(tj, planes, w, strides, h, subsamp, &buf, &size, quality, TJFLAG_NOREALLOC);
+			} else {
+				const int pf = (subsamp == TJSAMP_GRAY) ? (TJPF_GRAY) : (TJPF_RGB);
+				res = tjCompress2(tj, src.getData(), w, 0, h, pf, &buf, &size, subsamp, quality, TJFLAG_NOREALLOC);
+			}
+
+			if (res != 0) {throw ConverterException(std::string("turbojpeg: ") + tjGetErrorStr2(tj));}
+			dst.setParameters( w, h, PixelFormat(V4L2_PIX_FMT_JPEG), (uint32_t) size );
+			return true;
+
+		}
+		#endif
+
+
+		/** one strip for parallel encoding (kept across images) */
+		struct Strip {
+			std::unique_ptr<JPEGEncoder> enc;
+			WebcamImage jpeg;
+			JPEGSegments seg;
+			Strip() : enc(new JPEGEncoder()) {;}
+		};
+
+		/** the compressor */
+		struct jpeg_compress_struct cinfo;
+		struct jpeg_error_mgr jerr;
+		struct jpeg_destination_mgr jdest;
+
+		#ifdef K_USE_TURBOJPEG
+		tjhandle tj;
+		#endif
+
+		/** the current configuration */
+		Input input;
+		uint32_t width;
+		uint32_t height;
+		uint8_t quality;
+		uint32_t restartInterval;
+
+		/** the size of the current output buffer */
+		uint32_t maxSize;
+
+		/** padded row-lengths for raw input */
+		uint32_t padW;
+		uint32_t padCW;
+
+		/** buffer for padded / de-interleaved rows (raw input) */
+		std::vector<uint8_t> rows;
+
+		/** the strips for parallel encoding */
+		std::vector<std::unique_ptr<Strip>> strips;
+
+		/** hidden copy ctor */
+		JPEGEncoder(const JPEGEncoder&);
+
+		/** hidden assignment operator */
+		JPEGEncoder& operator = (const JPEGEncoder&);
+
+	};
+
+}
+
+#endif // K_JPEGENCODER_H
@@ -0,0 +1,23 @@
+#ifndef K_JPEGERROR_H
+#define K_JPEGERROR_H
+
+#include <cstdio>
+#include <string>
+
+#include <jerror.h>
+#include <jpeglib.h>
+
+#include "../ConverterException.h"
+
+namespace K {
+
+	/** libjpeg calls exit() on errors by default. throw instead */
+	static void jpegErrorExit (j_common_ptr cinfo) {
+		char msg[JMSG_LENGTH_MAX];
+		(*cinfo->err->format_message) (cinfo, msg);
+		throw ConverterException(std::string("libjpeg: ") + msg);
+	}
+
+}
+
+#endif // K_JPEGERROR_H
@@ -0,0 +1,103 @@
+#ifndef K_JPEGMARKERS_H
+#define K_JPEGMARKERS_H
+
+#include <cstdint>
+
+namespace K {
+
+	/** the markers of a JPEG (without the leading 0xFF) */
+	enum JPEGMarker : uint8_t {
+		JPEG_MARKER_SOF0	= 0xC0,
+		JPEG_MARKER_DHT		= 0xC4,
+		JPEG_MARKER_JPG		= 0xC8,
+		JPEG_MARKER_DAC		= 0xCC,
+		JPEG_MARKER_RST0	= 0xD0,
+		JPEG_MARKER_RST7	= 0xD7,
+		JPEG_MARKER_SOI		= 0xD8,
+		JPEG_MARKER_EOI		= 0xD9,
+		JPEG_MARKER_SOS		= 0xDA,
+		JPEG_MARKER_DRI		= 0xDD,
+		JPEG_MARKER_TEM		= 0x01,
+	};
+
+	/** the position of the relevant segments within a JPEG */
+	struct JPEGSegments {
+
+		/** offset of the (first) SOFn marker's 0xFF. -1 if missing */
+		int32_t sof;
+
+		/** offset of the SOS marker's 0xFF. -1 if missing */
+		int32_t sos;
+
+		/** offset of the DRI marker's 0xFF. -1 if missing */
+		int32_t dri;
+
+		/** offset of the entropy-coded data (following the SOS segment). -1 if missing */
+		int32_t scan;
+
+		/** does the JPEG contain (at least one) huffman table? */
+		bool hasDHT;
+
+		/** ctor */
+		JPEGSegments() : sof(-1), sos(-1), dri(-1), scan(-1), hasDHT(false) {;}
+
+	};
+
+	/** is the given marker a start-of-frame (SOF0 ... SOF15, except DHT, JPG and DAC)? */
+	static inline bool isJPEGSOF(const uint8_t marker) {
+		return (marker >= 0xC0 && marker <= 0xCF) && marker != JPEG_MARKER_DHT && marker != JPEG_MARKER_JPG && marker != JPEG_MARKER_DAC;
+	}
+
+	/**
+	 * walk the segments of a JPEG, from SOI up to (and including) the SOS marker,
+	 * using the segments' lengths. the entropy-coded data is not scanned.
+	 * @return false if the data is no valid JPEG (no SOI, truncated segment, no SOF/SOS)
+	 */
+	static bool parseJPEGSegments(const uint8_t* data, const uint32_t length, JPEGSegments& seg) {
+
+		seg = JPEGSegments();
+
+		// SOI
+		if (length < 4 || data[0] != 0xFF || data[1] != JPEG_MARKER_SOI) {return false;}
+		uint32_t pos = 2;
+
+		while (pos + 1 < length) {
+
+			// each marker starts with 0xFF (optionally followed by more 0xFF fill-bytes)
+			if (data[pos] != 0xFF) {return false;}
+			const uint32_t start = pos;
+			while (pos < length && data[pos] == 0xFF) {++pos;}
+			if (pos >= length) {return false;}
+			const uint8_t marker = data[pos++];
+
+			// markers without a segment
+			if (marker == JPEG_MARKER_TEM || (marker >= JPEG_MARKER_RST0 && marker <= JPEG_MARKER_RST7)) {continue;}
+			if (marker == JPEG_MARKER_EOI) {return false;}
+
+			// segment length (including the two length bytes)
+			if (pos + 2 > length) {return false;}
+			const uint32_t segLength = ((uint32_t) data[pos] << 8) | data[pos+1];
+			if (segLength < 2 || pos + segLength > length) {return false;}
+
+			if (marker == JPEG_MARKER_DHT)	{seg.hasDHT = true;}
+			if (marker == JPEG_MARKER_DRI)	{seg.dri = start;}
+			if (isJPEGSOF(marker) && seg.sof < 0)	{seg.sof = start;}
+
+			// the entropy-coded data follows the SOS -> done
+			if (marker == JPEG_MARKER_SOS) {
+				seg.sos = start;
+				seg.scan = pos + segLength;
+				return seg.sof >= 0;
+			}
+
+			pos += segLength;
+
+		}
+
+		return false;
+
+	}
+
+}
+
+#endif // K_JPEGMARKERS_H
@@ -1,7 +1,13 @@
 #ifndef K_MJPEG_JPEG_H
 #define K_MJPEG_JPEG_H
 
+#include <cstring>
+#include <sys/uio.h>
+
 #include "../PixelFormat.h"
+#include "../WebcamImage.h"
+#include "../ConverterException.h"
+#include "JPEGMarkers.h"
 
 namespace K {
 
@@ -37,15 +43,15 @@ namespace K {
 	static const uint8_t jpegDHT[] = {JPEG_DHT_DATA};
 
 
-	/** find first occurence of "byte" within "srcBuffer" */
-	static int32_t _findByte(uint32_t srcLength, const uint8_t* srcBuffer, const uint8_t byte) {
-		for (uint32_t i = 0; i < srcLength; ++i) {
-			if (*(srcBuffer+i) == byte) {return i;}
-		}
-		return -1;
-	}
+	/** the size of the huffman-table to append to MJPEG files */
+	static const uint32_t jpegDHTSize = sizeof(jpegDHT);
 
-	#include "../WebcamImage.h"
+	/** the position where to insert the DHT into an MJPEG (before the SOF). -1 if no DHT is needed */
+	static int32_t getMJPEGSplitPos(const WebcamImage& src) {
+		JPEGSegments seg;
+		if (!parseJPEGSegments(src.getData(), src.getNumBytes(), seg)) {throw ConverterException("invalid MJPEG image");}
+		return (seg.hasDHT) ? (-1) : (seg.sof);
+	}
 
 	/**
 	 * this method will convert an image in MJPEG format
@@ -56,21 +62,68 @@ namespace K {
 		const uint32_t srcLength = src.getNumBytes();
 		const uint8_t* srcBuffer = src.getData();
 
-		dst.ensureSpace(srcLength + 420);
-		uint8_t* dstBuffer = dst.getData();
-
 		// find the position in the src MJPEG where to insert the missing DHT (Huffman Table)
-		// search for 0xFFC0
-		// TODO currently only searching for 0xC0. also check the preceding 0xFF??
-		int32_t splitPos = _findByte(srcLength, srcBuffer, 0xC0) - 1;
+		const int32_t splitPos = getMJPEGSplitPos(src);
+
+		// already complete
+		if (splitPos < 0) {
+			dst.ensureSpace(srcLength);
+			memcpy(dst.getData(), srcBuffer, srcLength);
+			dst.setParameters( src.getWidth(), src.getHeight(), PixelFormat(V4L2_PIX_FMT_JPEG), srcLength );
+			return;
+		}
+
+		dst.ensureSpace(srcLength + jpegDHTSize);
+		uint8_t* dstBuffer = dst.getData();
 
 		// create output
-		memcpy(dstBuffer + 0,				srcBuffer + 0,			splitPos);				// add jpeg header skipping
-		memcpy(dstBuffer + splitPos,		jpegDHT,				420);					// add the DHT huffman table
-		memcpy(dstBuffer + splitPos + 420,	srcBuffer + splitPos,	srcLength - splitPos);	// add the rest of the image
+		memcpy(dstBuffer + 0,							srcBuffer + 0,			splitPos);				// add jpeg header skipping
+		memcpy(dstBuffer + splitPos,					jpegDHT,				jpegDHTSize);			// add the DHT huffman table
+		memcpy(dstBuffer + splitPos + jpegDHTSize,		srcBuffer + splitPos,	srcLength - splitPos);	// add the rest of the image
 
 		// set
-		dst.setParameters( src.getWidth(), src.getHeight(), PixelFormat(V4L2_PIX_FMT_JPEG), (srcLength + 420) );
+		dst.setParameters( src.getWidth(), src.getHeight(), PixelFormat(V4L2_PIX_FMT_JPEG), (srcLength + jpegDHTSize) );
+
+	}
+
+	/**
+	 * get a valid JPEG for the given MJPEG image. the result always is tmp, tagged as JPEG.
+	 * if the MJPEG already contains a DHT, tmp just points to the source's data (no copy)
+	 * and is only valid as long as the source is. otherwise the JPEG is created within tmp
+	 * (see convertMJPEGtoJPEG())
+	 */
+	static const WebcamImage& getMJPEGasJPEG(const WebcamImage& src, WebcamImage& tmp) {
+		if (getMJPEGSplitPos(src) < 0) {
+			tmp.wrap(src.getData(), src.getNumBytes());
+			tmp.setParameters( src.getWidth(), src.getHeight(), PixelFormat(V4L2_PIX_FMT_JPEG), src.getNumBytes() );
+			return tmp;
+		}
+		convertMJPEGtoJPEG(src, tmp);
+		return tmp;
+	}
+
+	/**
+	 * describe the JPEG for the given MJPEG image as scatter/gather list (header, DHT, rest)
+	 * e.g. for writev() or sendmsg(), without creating a copy.
+	 * the iovecs point into the source image (and the static DHT) and are
+	 * only valid as long as the source image is.
+	 * @return the number of used iovecs: 1 if the MJPEG already contains a DHT, 3 otherwise
+	 */
+	static int getMJPEGasJPEG(const WebcamImage& src, struct iovec iov[3]) {
+
+		uint8_t* srcBuffer = src.getData();
+		const uint32_t srcLength = src.getNumBytes();
+		const int32_t splitPos = getMJPEGSplitPos(src);
+
+		if (splitPos < 0) {
+			iov[0].iov_base = srcBuffer;					iov[0].iov_len = srcLength;
+			return 1;
+		}
+
+		iov[0].iov_base = srcBuffer;						iov[0].iov_len = splitPos;
+		iov[1].iov_base = (void*) jpegDHT;					iov[1].iov_len = jpegDHTSize;
+		iov[2].iov_base = srcBuffer + splitPos;				iov[2].iov_len = srcLength - splitPos;
+		return 3;
 
 	}
 
@@ -0,0 +1,485 @@
+#ifndef K_PNGENCODER_H
+#define K_PNGENCODER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "../PixelFormat.h"
+#include "../../Debug.h"
+#include "../ConverterException.h"
+#include "../WebcamImage.h"
+#include "../ThreadPool.h"
+
+namespace K {
+
+	/** the filter to apply to each row before compressing it */
+	enum class PNGFilter : uint8_t {
+		NONE = 0,
+		SUB = 1,
+		UP = 2,
+		AVERAGE = 3,
+		PAETH = 4,
+		ADAPTIVE = 5,			// try all filters for each row and use the best one (libpng's default. slow)
+	};
+
+	/** speed / size tradeoff for the PNGEncoder */
+	struct PNGSettings {
+
+		/** zlib's compression level (0 = store, 1 = fastest ... 9 = smallest) */
+		int level;
+
+		/** the filter to use for all rows */
+		PNGFilter filter;
+
+		/** zlib's strategy (Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE, Z_HUFFMAN_ONLY) */
+		int strategy;
+
+		/** ctor */
+		PNGSettings(const int level, const PNGFilter filter, const int strategy) : level(level), filter(filter), strategy(strategy) {;}
+
+		/** fastest encoding, larger files. run-length encoding of the vertical differences */
+		static PNGSettings fastest()	{return PNGSettings(1, PNGFilter::UP, Z_RLE);}
+
+		/** fast encoding, reasonable size for camera images */
+		static PNGSettings fast()		{return PNGSettings(1, PNGFilter::PAETH, Z_RLE);}
+
+		/** the same as libpng's defaults: small files, slow */
+		static PNGSettings small()		{return PNGSettings(6, PNGFilter::ADAPTIVE, Z_FILTERED);}
+
+		bool operator == (const PNGSettings& o) const {return level == o.level && filter == o.filter && strategy == o.strategy;}
+		bool operator != (const PNGSettings& o) const {return !(*this == o);}
+
+	};
+
+	/** apply the given filter (not ADAPTIVE) to the row cur (prev = the row above, nullptr for the first one) */
+	static void filterPNGRow(const PNGFilter filter, const uint8_t* cur, const uint8_t* prev, uint8_t* dst, const uint32_t stride, const uint32_t bpp) {
+
+		switch (filter) {
+
+			case PNGFilter::NONE:
+				memcpy(dst, cur, stride);
+				break;
+
+			case PNGFilter::SUB:
+				memcpy(dst, cur, bpp);
+				for (uint32_t i = bpp; i < stride; ++i) {dst[i] = cur[i] - cur[i-bpp];}
+				break;
+
+			case PNGFilter::UP:
+				if (!prev) {memcpy(dst, cur, stride); break;}
+				for (uint32_t i = 0; i < stride; ++i) {dst[i] = cur[i] - prev[i];}
+				break;
+
+			case PNGFilter::AVERAGE:
+				if (!prev) {
+					memcpy(dst, cur, bpp);
+					for (uint32_t i = bpp; i < stride; ++i) {dst[i] = cur[i] - (cur[i-bpp] >> 1);}
+					break;
+				}
+				for (uint32_t i = 0; i < bpp; ++i) {dst[i] = cur[i] - (prev[i] >> 1);}
+				for (uint32_t i = bpp; i < stride; ++i) {dst[i] = cur[i] - ((cur[i-bpp] + prev[i]) >> 1);}
+				break;
+
+			case PNGFilter::PAETH:
+				// without a row above, paeth is the same as sub
+				if (!prev) {filterPNGRow(PNGFilter::SUB, cur, prev, dst, stride, bpp); break;}
+				for (uint32_t i = 0; i < bpp; ++i) {dst[i] = cur[i] - prev[i];}
+				for (uint32_t i = bpp; i < stride; ++i) {
+					const int a = cur[i-bpp];
+					const int b = prev[i];
+					const int c = prev[i-bpp];
+					const int pa = std::abs(b - c);
+					const int pb = std::abs(a - c);
+					const int pc = std::abs(a + b - 2*c);
+					const int p = (pa <= pb && pa <= pc) ? (a) : ((pb <= pc) ? (b) : (c));
+					dst[i] = cur[i] - p;
+				}
+				break;
+
+			default:
+				throw ConverterException("png: unsupported filter");
+
+		}
+
+	}
+
+	/**
+	 * filter one row into dst (the filter-type byte followed by stride bytes).
+	 * for ADAPTIVE, the filter with the smallest sum of absolute (signed) differences is used
+	 * and tmp (stride+1 bytes) is needed as scratch
+	 */
+	static void filterPNGLine(const PNGFilter filter, const uint8_t* cur, const uint8_t* prev, uint8_t* dst, uint8_t* tmp, const uint32_t stride, const uint32_t bpp) {
+
+		PNGFilter use = filter;
+
+		if (filter == PNGFilter::ADAPTIVE) {
+			uint64_t best = UINT64_MAX;
+			for (uint8_t f = 0; f < 5; ++f) {
+				filterPNGRow((PNGFilter) f, cur, prev, tmp, stride, bpp);
+				uint64_t sum = 0;
+				for (uint32_t i = 0; i < stride; ++i) {sum += std::abs((int8_t) tmp[i]);}
+				if (sum < best) {best = sum; use = (PNGFilter) f;}
+			}
+		}
+
+		dst[0] = (uint8_t) use;
+		filterPNGRow(use, cur, prev, dst + 1, stride, bpp);
+
+	}
+
+	/**
+	 * PNG encoder that writes the PNG's chunks itself and compresses
+	 * the filtered rows using zlib.
+	 *
+	 * the deflate-stream (and its ~256 KB of state) is kept across images
+	 * and only reset for each new one. the output is presized using
+	 * deflateBound() so the whole image is compressed in one pass,
+	 * directly into the destination.
+	 *
+	 * given a thread-pool, horizontal stripes of the image are filtered and
+	 * compressed in parallel (like pigz). each stripe is a raw deflate-stream,
+	 * primed with the last 32 KB of (filtered) data preceding it and ending
+	 * with a sync-flush (byte-aligned), so the stripes can simply be
+	 * concatenated into one zlib-stream. the adler32 checksums are combined.
+	 * the result is a standard PNG, slightly larger than the serial one.
+	 *
+	 * supported inputs:
+	 *		V4L2_PIX_FMT_RGB24, V4L2_PIX_FMT_GREY
+	 *
+	 * not thread-safe. use one encoder per thread.
+	 */
+	class PNGEncoder {
+
+	public:
+
+		/** ctor */
+		PNGEncoder(const PNGSettings& settings = PNGSettings::fast()) : settings(settings), active(settings) {
+
+			memset(&zs, 0, sizeof(zs));
+			const int res = deflateInit2(&zs, settings.level, Z_DEFLATED, 15, 8, settings.strategy);
+			if (res != Z_OK) {throw ConverterException("png: could not create the compressor");}
+
+		}
+
+		/** dtor */
+		~PNGEncoder() {
+			deflateEnd(&zs);
+		}
+
+		/** get the current settings */
+		const PNGSettings& getSettings() const {return settings;}
+
+		/** change the speed / size tradeoff. applies to the next image */
+		void setSettings(const PNGSettings& settings) {
+			this->settings = settings;
+		}
+
+		/**
+		 * encode the given image (see supported inputs).
+		 * the optional pool compresses several stripes of rows in parallel
+		 */
+		void encode(const WebcamImage& src, WebcamImage& dst, ThreadPool* pool = nullptr) {
+
+			traceScope("encode.png", src.getSequence());
+
+			uint8_t colorType;
+			uint32_t bpp;
+			switch (src.getPixelFormat()._int) {
+				case V4L2_PIX_FMT_GREY:		colorType = 0; bpp = 1; break;
+				case V4L2_PIX_FMT_RGB24:	colorType = 2; bpp = 3; break;
+				default: throw ConverterException("png does not support this input format", src.getPixelFormat());
+			}
+
+			const uint32_t w = src.getWidth();
+			const uint32_t h = src.getHeight();
+			const uint32_t stride = w * bpp;
+
+			// stripes should be large compared to the 32 KB dictionary each one needs
+			if (pool && pool->getNumThreads() > 1) {
+				const uint32_t minRows = (4 * 32768 + stride) / (stride + 1);
+				uint32_t rows = pool->getStripeRows(h, 1);
+				if (rows < minRows) {rows = minRows;}
+				if (rows < h) {encodeParallel(src, dst, *pool, colorType, bpp, rows); return;}
+			}
+
+			debugVerbose("PNGEncoder", "converting to PNG");
+
+			configure();
+
+			// the uncompressed size: one filter-type byte per row
+			const uLong rawSize = (uLong) (stride + 1) * h;
+			const uLong maxIDAT = deflateBound(&zs, rawSize);
+			dst.ensureSpace(33 + 12 + maxIDAT + 12);
+			uint8_t* out = dst.getData();
+			uint32_t pos = writeHeader(out, w, h, colorType);
+
+			// compress all rows into one IDAT chunk
+			uint8_t* idat = out + pos;
+			zs.next_out = idat + 8;
+			zs.avail_out = (uInt) maxIDAT;
+
+			line.resize(stride + 1);
+			tmp.resize(stride + 1);
+
+			const uint8_t* srcBuffer = src.getData();
+			for (uint32_t y = 0; y < h; ++y) {
+				const uint8_t* cur = srcBuffer + y*stride;
+				const uint8_t* prev = (y > 0) ? (cur - stride) : (nullptr);
+				filterPNGLine(settings.filter, cur, prev, line.data(), tmp.data(), stride, bpp);
+				zs.next_in = line.data();
+				zs.avail_in = stride + 1;
+				check(zs, deflate(&zs, Z_NO_FLUSH), Z_OK);
+			}
+			check(zs, deflate(&zs, Z_FINISH), Z_STREAM_END);
+
+			pos += finishChunk(idat, "IDAT", (uint32_t) zs.total_out);
+			pos += writeChunk(out + pos, "IEND", nullptr, 0);
+
+			dst.setParameters(w, h, PixelFormat(0), pos);
+
+		}
+
+	private:
+
+		/** the state of one stripe for parallel encoding (kept across images) */
+		struct Stripe {
+
+			/** raw deflate-stream (no zlib header / checksum) */
+			z_stream zs;
+			bool initialized;
+			PNGSettings active;
+
+			/** filtered rows */
+			std::vector<uint8_t> line;
+			std::vector<uint8_t> tmp;
+			std::vector<uint8_t> dict;
+
+			/** the compressed stripe */
+			std::vector<uint8_t> out;
+			uint32_t outSize;
+
+			/** the adler32 and size of the uncompressed (filtered) stripe */
+			uLong adler;
+			uLong rawSize;
+
+			/** ctor */
+			Stripe() : initialized(false), active(PNGSettings::fast()), outSize(0), adler(0), rawSize(0) {
+				memset(&zs, 0, sizeof(zs));
+			}
+
+			/** dtor */
+			~Stripe() {
+				if (initialized) {deflateEnd(&zs);}
+			}
+
+		};
+
+		/** apply the configured settings to the (reset) deflate-stream */
+		void configure() {
+
+			deflateReset(&zs);
+			if (settings == active) {return;}
+
+			debug("PNGEncoder", "configuring level " << settings.level << ", filter " << (int) settings.filter << ", strategy " << settings.strategy);
+			check(zs, deflateParams(&zs, settings.level, settings.strategy), Z_OK);
+			active = settings;
+
+		}
+
+		/** compress stripes of the given number of rows in parallel and concatenate them */
+		void encodeParallel(const WebcamImage& src, WebcamImage& dst, ThreadPool& pool, const uint8_t colorType, const uint32_t bpp, const uint32_t rows) {
+
+			const uint32_t w = src.getWidth();
+			const uint32_t h = src.getHeight();
+			const uint32_t numStripes = (h + rows - 1) / rows;
+
+			debugVerbose("PNGEncoder", "converting to PNG using " << numStripes << " stripes");
+
+			while (stripes.size() < numStripes) {stripes.push_back(std::unique_ptr<Stripe>(new Stripe()));}
+
+			pool.parallelFor(numStripes, [&] (const uint32_t i) {
+				const uint32_t y0 = i * rows;
+				const uint32_t y1 = (y0 + rows < h) ? (y0 + rows) : (h);
+				encodeStripe(*stripes[i], src, bpp, y0, y1);
+			});
+
+			// IDAT = zlib header + all stripes + combined adler32
+			uint32_t idatSize = 2 + 4;
+			uLong adler = adler32(0, nullptr, 0);
+			for (uint32_t i = 0; i < numStripes; ++i) {
+				idatSize += stripes[i]->outSize;
+				adler = adler32_combine(adler, stripes[i]->adler, stripes[i]->rawSize);
+			}
+
+			dst.ensureSpace(33 + 12 + idatSize + 12);
+			uint8_t* out = dst.getData();
+			uint32_t pos = writeHeader(out, w, h, colorType);
+
+			uint8_t* idat = out + pos;
+			uint8_t* ptr = idat + 8;
+			writeZlibHeader(ptr, settings.level); ptr += 2;
+			for (uint32_t i = 0; i < numStripes; ++i) {
+				memcpy(ptr, stripes[i]->out.data(), stripes[i]->outSize);
+				ptr += stripes[i]->outSize;
+			}
+			setBE32(ptr, (uint32_t) adler);
+
+			pos += finishChunk(idat, "IDAT", idatSize);
+			pos += writeChunk(out + pos, "IEND", nullptr, 0);
+
+			dst.setParameters(w, h, PixelFormat(0), pos);
+
+		}
+
+		/** filter and compress the rows [y0, y1) into the given stripe */
+		void encodeStripe(Stripe& s, const WebcamImage& src, const uint32_t bpp, const uint32_t y0, const uint32_t y1) const {
+
+			const uint32_t h = src.getHeight();
+			const uint32_t stride = src.getWidth() * bpp;
+			const uint8_t* srcBuffer = src.getData();
+			const bool last = (y1 == h);
+
+			// (re)configure the stripe's compressor
+			if (!s.initialized) {
+				if (deflateInit2(&s.zs, settings.level, Z_DEFLATED, -15, 8, settings.strategy) != Z_OK) {throw ConverterException("png: could not create the compressor");}
+				s.initialized = true;
+				s.active = settings;
+			} else {
+				deflateReset(&s.zs);
+				if (s.active != settings) {check(s.zs, deflateParams(&s.zs, settings.level, settings.strategy), Z_OK); s.active = settings;}
+			}
+
+			s.line.resize(stride + 1);
+			s.tmp.resize(stride + 1);
+
+			// prime the dictionary with the last 32 KB the previous stripe compresses (re-filtering its last rows)
+			if (y0 > 0) {
+				uint32_t dictRows = (32768 + stride) / (stride + 1);
+				if (dictRows > y0) {dictRows = y0;}
+				s.dict.resize(dictRows * (stride + 1));
+				for (uint32_t i = 0; i < dictRows; ++i) {
+					const uint32_t y = y0 - dictRows + i;
+					const uint8_t* cur = srcBuffer + y*stride;
+					const uint8_t* prev = (y > 0) ? (cur - stride) : (nullptr);
+					filterPNGLine(settings.filter, cur, prev, &s.dict[i * (stride + 1)], s.tmp.data(), stride, bpp);
+				}
+				const uint32_t dictSize = (s.dict.size() < 32768) ? ((uint32_t) s.dict.size()) : (32768);
+				check(s.zs, deflateSetDictionary(&s.zs, s.dict.data() + s.dict.size() - dictSize, dictSize), Z_OK);
+			}
+
+			// some extra space for the sync-flush marker
+			s.rawSize = (uLong) (y1 - y0) * (stride + 1);
+			s.out.resize(deflateBound(&s.zs, s.rawSize) + 64);
+			s.zs.next_out = s.out.data();
+			s.zs.avail_out = (uInt) s.out.size();
+			s.adler = adler32(0, nullptr, 0);
+
+			for (uint32_t y = y0; y < y1; ++y) {
+				const uint8_t* cur = srcBuffer + y*stride;
+				const uint8_t* prev = (y > 0) ? (cur - stride) : (nullptr);
+				filterPNGLine(settings.filter, cur, prev, s.line.data(), s.tmp.data(), stride, bpp);
+				s.adler = adler32(s.adler, s.line.data(), stride + 1);
+				s.zs.next_in = s.line.data();
+				s.zs.avail_in = stride + 1;
+				check(s.zs, deflate(&s.zs, Z_NO_FLUSH), Z_OK);
+			}
+
+			// the last stripe ends the stream, all others end byte-aligned
+			if (last)	{check(s.zs, deflate(&s.zs, Z_FINISH), Z_STREAM_END);}
+			else		{check(s.zs, deflate(&s.zs, Z_SYNC_FLUSH), Z_OK);}
+			if (s.zs.avail_out == 0) {throw ConverterException("png: stripe buffer too small");}
+
+			s.outSize = (uint32_t) s.zs.total_out;
+
+		}
+
+		/** throw if zlib did not return the expected code */
+		static void check(const z_stream& zs, const int res, const int expected) {
+			if (res == expected) {return;}
+			const std::string msg = (zs.msg) ? (std::string(zs.msg)) : ("error " + std::to_string(res));
+			throw ConverterException("zlib: " + msg);
+		}
+
+		static inline void setBE32(uint8_t* dst, const uint32_t val) {
+			dst[0] = (uint8_t) (val >> 24);
+			dst[1] = (uint8_t) (val >> 16);
+			dst[2] = (uint8_t) (val >> 8);
+			dst[3] = (uint8_t) (val >> 0);
+		}
+
+		/** write the PNG signature and the IHDR chunk. returns their size (33) */
+		static uint32_t writeHeader(uint8_t* dst, const uint32_t w, const uint32_t h, const uint8_t colorType) {
+
+			static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+			memcpy(dst, signature, 8);
+
+			uint8_t ihdr[13];
+			setBE32(ihdr + 0, w);
+			setBE32(ihdr + 4, h);
+			ihdr[8] = 8;				// bits per sample
+			ihdr[9] = colorType;
+			ihdr[10] = 0;				// deflate
+			ihdr[11] = 0;				// adaptive filtering
+			ihdr[12] = 0;				// no interlacing
+			return 8 + writeChunk(dst + 8, "IHDR", ihdr, 13);
+
+		}
+
+		/** write the 2 byte zlib header (32 KB window) for a stream of raw deflate-data */
+		static void writeZlibHeader(uint8_t* dst, const int level) {
+			const uint8_t cmf = 0x78;
+			const uint8_t flevel = (level >= 0 && level < 2) ? (0) : ((level >= 2 && level < 6) ? (1) : ((level >= 7) ? (3) : (2)));
+			uint8_t flg = (uint8_t) (flevel << 6);
+			flg += 31 - ((cmf * 256 + flg) % 31);
+			dst[0] = cmf;
+			dst[1] = flg;
+		}
+
+		/** write a complete chunk. returns its size */
+		static uint32_t writeChunk(uint8_t* dst, const char* type, const uint8_t* data, const uint32_t length) {
+			if (length) {memcpy(dst + 8, data, length);}
+			return finishChunk(dst, type, length);
+		}
+
+		/** add length, type and CRC to a chunk whose data was written to dst+8. returns its size */
+		static uint32_t finishChunk(uint8_t* dst, const char* type, const uint32_t length) {
+			setBE32(dst, length);
+			memcpy(dst + 4, type, 4);
+			setBE32(dst + 8 + length, (uint32_t) crc32(0, dst + 4, 4 + length));
+			return 12 + length;
+		}
+
+
+		/** the compressor */
+		z_stream zs;
+
+		/** the requested settings */
+		PNGSettings settings;
+
+		/** the settings the compressor is configured for */
+		PNGSettings active;
+
+		/** the current filtered row (and scratch for ADAPTIVE) */
+		std::vector<uint8_t> line;
+		std::vector<uint8_t> tmp;
+
+		/** per-stripe compressors for parallel encoding */
+		std::vector<std::unique_ptr<Stripe>> stripes;
+
+		/** hidden copy ctor */
+		PNGEncoder(const PNGEncoder&);
+
+		/** hidden assignment operator */
+		PNGEncoder& operator = (const PNGEncoder&);
+
+	};
+
+}
+
+#endif // K_PNGENCODER_H
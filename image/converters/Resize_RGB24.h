@@ -0,0 +1,384 @@
+#ifndef K_RESIZE_RGB24_H
+#define K_RESIZE_RGB24_H
+
+#include <algorithm>
+#include <vector>
+
+#include "YUV.h"
+#include "../WebcamImage.h"
+#include "../ThreadPool.h"
+#include "../ConverterException.h"
+
+/**
+ * convert to RGB24 and resize within the same pass over the source.
+ *
+ * the source is sampled in its own color space (YUV / grey) and only
+ * the resampled pixels are converted to RGB. no full-size intermediate
+ * image is created and the destination only has the requested size.
+ *
+ * integer ratios (e.g. 1920x1080 -> 480x270) use a box filter (average
+ * of all source pixels covered by the destination pixel), all other
+ * ratios (and upscaling) use bilinear interpolation.
+ */
+
+namespace K {
+
+	/** samples YUYV (YUV422) images */
+	struct YUYVSampler {
+
+		const uint8_t* data;
+		uint32_t w;
+
+		YUYVSampler(const WebcamImage& src) : data(src.getData()), w(src.getWidth()) {;}
+
+		/** get the Y, U and V of the given pixel */
+		inline void get(const uint32_t x, const uint32_t y, int& c0, int& c1, int& c2) const {
+			const uint8_t* pair = data + (y*w + (x & ~1u)) * 2;
+			c0 = pair[(x & 1) * 2];
+			c1 = pair[1];
+			c2 = pair[3];
+		}
+
+		/** add the Y, U and V of n consecutive pixels to the given sums */
+		inline void sum(uint32_t x, const uint32_t y, uint32_t n, int& s0, int& s1, int& s2) const {
+			int c0, c1, c2;
+			if (n && (x & 1)) {get(x, y, c0, c1, c2); s0 += c0; s1 += c1; s2 += c2; ++x; --n;}
+			const uint8_t* pair = data + (y*w + x) * 2;
+			for (; n >= 2; n -= 2, x += 2, pair += 4) {
+				s0 += pair[0] + pair[2];
+				s1 += pair[1] * 2;
+				s2 += pair[3] * 2;
+			}
+			if (n) {get(x, y, c0, c1, c2); s0 += c0; s1 += c1; s2 += c2;}
+		}
+
+		/** convert the sampled values to RGB */
+		static inline void toRGB(const int c0, const int c1, const int c2, uint8_t* dst) {
+			YUVtoRGB(c0, c1, c2, dst[0], dst[1], dst[2]);
+		}
+
+	};
+
+	/** samples YUV420 (planar) images */
+	struct YUV420Sampler {
+
+		const uint8_t* data;
+		const uint8_t* u;
+		const uint8_t* v;
+		uint32_t w;
+		uint32_t cw;
+
+		YUV420Sampler(const WebcamImage& src) :
+			data(src.getData()), w(src.getWidth()), cw((src.getWidth() + 1) / 2) {
+			u = data + w * src.getHeight();
+			v = u + cw * ((src.getHeight() + 1) / 2);
+		}
+
+		/** get the Y, U and V of the given pixel */
+		inline void get(const uint32_t x, const uint32_t y, int& c0, int& c1, int& c2) const {
+			const uint32_t idx = (y/2)*cw + x/2;
+			c0 = data[y*w + x];
+			c1 = u[idx];
+			c2 = v[idx];
+		}
+
+		/** add the Y, U and V of n consecutive pixels to the given sums */
+		inline void sum(const uint32_t x, const uint32_t y, const uint32_t n, int& s0, int& s1, int& s2) const {
+			for (uint32_t i = x; i < x + n; ++i) {
+				s0 += data[y*w + i];
+				s1 += u[(y/2)*cw + i/2];
+				s2 += v[(y/2)*cw + i/2];
+			}
+		}
+
+		/** convert the sampled values to RGB */
+		static inline void toRGB(const int c0, const int c1, const int c2, uint8_t* dst) {
+			YUVtoRGB(c0, c1, c2, dst[0], dst[1], dst[2]);
+		}
+
+	};
+
+	/** samples YUV422P (planar, e.g. decoded from JPEG) images */
+	struct YUV422PSampler {
+
+		const uint8_t* data;
+		const uint8_t* u;
+		const uint8_t* v;
+		uint32_t w;
+		uint32_t cw;
+
+		YUV422PSampler(const WebcamImage& src) :
+			data(src.getData()), w(src.getWidth()), cw((src.getWidth() + 1) / 2) {
+			u = data + w * src.getHeight();
+			v = u + cw * src.getHeight();
+		}
+
+		/** get the Y, U and V of the given pixel */
+		inline void get(const uint32_t x, const uint32_t y, int& c0, int& c1, int& c2) const {
+			const uint32_t idx = y*cw + x/2;
+			c0 = data[y*w + x];
+			c1 = u[idx];
+			c2 = v[idx];
+		}
+
+		/** add the Y, U and V of n consecutive pixels to the given sums */
+		inline void sum(const uint32_t x, const uint32_t y, const uint32_t n, int& s0, int& s1, int& s2) const {
+			for (uint32_t i = x; i < x + n; ++i) {
+				s0 += data[y*w + i];
+				s1 += u[y*cw + i/2];
+				s2 += v[y*cw + i/2];
+			}
+		}
+
+		/** convert the sampled values to RGB */
+		static inline void toRGB(const int c0, const int c1, const int c2, uint8_t* dst) {
+			YUVtoRGB(c0, c1, c2, dst[0], dst[1], dst[2]);
+		}
+
+	};
+
+	/** samples Yxx (xx-bit grey-scale) images */
+	struct YxxSampler {
+
+		const uint8_t* data;
+		uint32_t w;
+		int shift;
+
+		YxxSampler(const int numBits, const WebcamImage& src) : data(src.getData()), w(src.getWidth()), shift(numBits - 8) {;}
+
+		/** get the (8 bit) grey of the given pixel */
+		inline void get(const uint32_t x, const uint32_t y, int& c0, int& c1, int& c2) const {
+			const uint8_t* px = data + (y*w + x) * 2;
+			c0 = (uint8_t) ((((uint16_t)px[0] << 0) | ((uint16_t)px[1] << 8)) >> shift);
+			c1 = 0;
+			c2 = 0;
+		}
+
+		/** add the grey of n consecutive pixels to the given sum */
+		inline void sum(const uint32_t x, const uint32_t y, const uint32_t n, int& s0, int& s1, int& s2) const {
+			(void) s1; (void) s2;
+			int c0, c1, c2;
+			for (uint32_t i = x; i < x + n; ++i) {get(i, y, c0, c1, c2); s0 += c0;}
+		}
+
+		/** convert the sampled values to RGB */
+		static inline void toRGB(const int c0, const int c1, const int c2, uint8_t* dst) {
+			(void) c1; (void) c2;
+			dst[0] = (uint8_t) c0;
+			dst[1] = (uint8_t) c0;
+			dst[2] = (uint8_t) c0;
+		}
+
+	};
+
+	/** samples GREY (8 bit grey-scale) images */
+	struct GREYSampler {
+
+		const uint8_t* data;
+		uint32_t w;
+
+		GREYSampler(const WebcamImage& src) : data(src.getData()), w(src.getWidth()) {;}
+
+		/** get the grey of the given pixel */
+		inline void get(const uint32_t x, const uint32_t y, int& c0, int& c1, int& c2) const {
+			c0 = data[y*w + x];
+			c1 = 0;
+			c2 = 0;
+		}
+
+		/** add the grey of n consecutive pixels to the given sum */
+		inline void sum(const uint32_t x, const uint32_t y, const uint32_t n, int& s0, int& s1, int& s2) const {
+			(void) s1; (void) s2;
+			const uint8_t* px = data + y*w + x;
+			for (uint32_t i = 0; i < n; ++i) {s0 += px[i];}
+		}
+
+		/** convert the sampled values to RGB */
+		static inline void toRGB(const int c0, const int c1, const int c2, uint8_t* dst) {
+			YxxSampler::toRGB(c0, c1, c2, dst);
+		}
+
+	};
+
+	/** samples RGB24 images (resizing only) */
+	struct RGB24Sampler {
+
+		const uint8_t* data;
+		uint32_t w;
+
+		RGB24Sampler(const WebcamImage& src) : data(src.getData()), w(src.getWidth()) {;}
+
+		/** get the R, G and B of the given pixel */
+		inline void get(const uint32_t x, const uint32_t y, int& c0, int& c1, int& c2) const {
+			const uint8_t* px = data + (y*w + x) * 3;
+			c0 = px[0];
+			c1 = px[1];
+			c2 = px[2];
+		}
+
+		/** add the R, G and B of n consecutive pixels to the given sums */
+		inline void sum(const uint32_t x, const uint32_t y, const uint32_t n, int& s0, int& s1, int& s2) const {
+			const uint8_t* px = data + (y*w + x) * 3;
+			for (uint32_t i = 0; i < n; ++i, px += 3) {s0 += px[0]; s1 += px[1]; s2 += px[2];}
+		}
+
+		/** nothing to convert */
+		static inline void toRGB(const int c0, const int c1, const int c2, uint8_t* dst) {
+			dst[0] = (uint8_t) c0;
+			dst[1] = (uint8_t) c1;
+			dst[2] = (uint8_t) c2;
+		}
+
+	};
+
+
+	/** box filter for integer ratios: average fx*fy source pixels for each destination pixel */
+	template <typename Sampler> static void resizeToRGB24Box(const Sampler& s, uint8_t* dstBuffer, const uint32_t dstW,
+															 const uint32_t dstY0, const uint32_t dstY1, const uint32_t fx, const uint32_t fy) {
+
+		const uint32_t n = fx * fy;
+		std::vector<int> sums(dstW * 3);
+
+		for (uint32_t dy = dstY0; dy < dstY1; ++dy) {
+
+			// sum up all covered source rows (reading each row sequentially)
+			std::fill(sums.begin(), sums.end(), 0);
+			for (uint32_t y = dy*fy; y < (dy+1)*fy; ++y) {
+				for (uint32_t dx = 0; dx < dstW; ++dx) {
+					int s0 = 0, s1 = 0, s2 = 0;
+					s.sum(dx*fx, y, fx, s0, s1, s2);
+					sums[dx*3+0] += s0; sums[dx*3+1] += s1; sums[dx*3+2] += s2;
+				}
+			}
+
+			// average and convert
+			uint8_t* dst = dstBuffer + dy*dstW*3;
+			for (uint32_t dx = 0; dx < dstW; ++dx) {
+				const int* sum = &sums[dx*3];
+				Sampler::toRGB((sum[0] + n/2) / n, (sum[1] + n/2) / n, (sum[2] + n/2) / n, dst + dx*3);
+			}
+
+		}
+
+	}
+
+	/** position and weight [0:256] of a bilinear sample */
+	struct ResizeTap {
+		uint32_t i0;
+		uint32_t i1;
+		int weight;
+	};
+
+	/** calculate the bilinear sampling positions for all destination pixels (pixel centers are aligned) */
+	static std::vector<ResizeTap> getResizeTaps(const uint32_t srcSize, const uint32_t dstSize) {
+		std::vector<ResizeTap> taps(dstSize);
+		for (uint32_t d = 0; d < dstSize; ++d) {
+			// ((d + 0.5) * srcSize / dstSize - 0.5) in 1/256 pixels
+			int64_t pos = ((int64_t)(2*d+1) * srcSize * 256) / (2*dstSize) - 128;
+			if (pos < 0) {pos = 0;}
+			taps[d].i0 = (uint32_t) (pos >> 8);
+			taps[d].i1 = (taps[d].i0 + 1 < srcSize) ? (taps[d].i0 + 1) : (srcSize - 1);
+			taps[d].weight = (int) (pos & 255);
+		}
+		return taps;
+	}
+
+	/** bilinear interpolation for arbitrary ratios */
+	template <typename Sampler> static void resizeToRGB24Bilinear(const Sampler& s, uint8_t* dstBuffer, const uint32_t dstW,
+																  const uint32_t dstY0, const uint32_t dstY1,
+																  const std::vector<ResizeTap>& tx, const std::vector<ResizeTap>& ty) {
+
+		for (uint32_t dy = dstY0; dy < dstY1; ++dy) {
+			uint8_t* dst = dstBuffer + dy*dstW*3;
+			const ResizeTap& y = ty[dy];
+			for (uint32_t dx = 0; dx < dstW; ++dx) {
+
+				const ResizeTap& x = tx[dx];
+				int a0, a1, a2, b0, b1, b2, c0, c1, c2, d0, d1, d2;
+				s.get(x.i0, y.i0, a0, a1, a2);
+				s.get(x.i1, y.i0, b0, b1, b2);
+				s.get(x.i0, y.i1, c0, c1, c2);
+				s.get(x.i1, y.i1, d0, d1, d2);
+
+				#define K_LERP(a, b, c, d) ( \
+					(((a) * (256 - x.weight) + (b) * x.weight) * (256 - y.weight) + \
+					 ((c) * (256 - x.weight) + (d) * x.weight) * y.weight + 32768) >> 16 )
+				Sampler::toRGB(K_LERP(a0, b0, c0, d0), K_LERP(a1, b1, c1, d1), K_LERP(a2, b2, c2, d2), dst + dx*3);
+				#undef K_LERP
+
+			}
+		}
+
+	}
+
+	/** resize and convert using the given sampler */
+	template <typename Sampler> static void resizeToRGB24(const Sampler& s, const WebcamImage& src, WebcamImage& dst,
+														  const uint32_t dstW, const uint32_t dstH, ThreadPool* pool) {
+
+		if (dstW == 0 || dstH == 0) {throw ConverterException("invalid target size for resizing");}
+
+		const uint32_t w = src.getWidth();
+		const uint32_t h = src.getHeight();
+
+		traceScope("resize", (uint64_t) dstW * dstH);
+
+		dst.ensureSpace(dstW*dstH*3);
+		uint8_t* dstBuffer = dst.getData();
+
+		if (w % dstW == 0 && h % dstH == 0) {
+
+			debugVerbose("ImageConverter", "resizing " << w << "x" << h << " -> " << dstW << "x" << dstH << " (box)");
+			const uint32_t fx = w / dstW;
+			const uint32_t fy = h / dstH;
+			forEachStripe(pool, dstH, 1, [&] (const uint32_t y0, const uint32_t y1) {
+				resizeToRGB24Box(s, dstBuffer, dstW, y0, y1, fx, fy);
+			});
+
+		} else {
+
+			debugVerbose("ImageConverter", "resizing " << w << "x" << h << " -> " << dstW << "x" << dstH << " (bilinear)");
+			const std::vector<ResizeTap> tx = getResizeTaps(w, dstW);
+			const std::vector<ResizeTap> ty = getResizeTaps(h, dstH);
+			forEachStripe(pool, dstH, 1, [&] (const uint32_t y0, const uint32_t y1) {
+				resizeToRGB24Bilinear(s, dstBuffer, dstW, y0, y1, tx, ty);
+			});
+
+		}
+
+		dst.setParameters( dstW, dstH, PixelFormat(V4L2_PIX_FMT_RGB24), (dstW*dstH*3) );
+
+	}
+
+	/** convert YUYV (YUV422) to RGB24 with the given size */
+	static void convertYUYVtoRGB24Resized(const WebcamImage& src, WebcamImage& dst, const uint32_t dstW, const uint32_t dstH, ThreadPool* pool = nullptr) {
+		resizeToRGB24(YUYVSampler(src), src, dst, dstW, dstH, pool);
+	}
+
+	/** convert YUV420 to RGB24 with the given size */
+	static void convertYUV420toRGB24Resized(const WebcamImage& src, WebcamImage& dst, const uint32_t dstW, const uint32_t dstH, ThreadPool* pool = nullptr) {
+		resizeToRGB24(YUV420Sampler(src), src, dst, dstW, dstH, pool);
+	}
+
+	/** convert YUV422P (planar) to RGB24 with the given size */
+	static void convertYUV422PtoRGB24Resized(const WebcamImage& src, WebcamImage& dst, const uint32_t dstW, const uint32_t dstH, ThreadPool* pool = nullptr) {
+		resizeToRGB24(YUV422PSampler(src), src, dst, dstW, dstH, pool);
+	}
+
+	/** convert Yxx (xx-bit grey-scale) to RGB24 with the given size */
+	static void convertYxxToRGB24Resized(const int numBits, const WebcamImage& src, WebcamImage& dst, const uint32_t dstW, const uint32_t dstH, ThreadPool* pool = nullptr) {
+		resizeToRGB24(YxxSampler(numBits, src), src, dst, dstW, dstH, pool);
+	}
+
+	/** convert GREY (8 bit grey-scale) to RGB24 with the given size */
+	static void convertGREYtoRGB24Resized(const WebcamImage& src, WebcamImage& dst, const uint32_t dstW, const uint32_t dstH, ThreadPool* pool = nullptr) {
+		resizeToRGB24(GREYSampler(src), src, dst, dstW, dstH, pool);
+	}
+
+	/** resize RGB24 to the given size */
+	static void resizeRGB24(const WebcamImage& src, WebcamImage& dst, const uint32_t dstW, const uint32_t dstH, ThreadPool* pool = nullptr) {
+		resizeToRGB24(RGB24Sampler(src), src, dst, dstW, dstH, pool);
+	}
+
+}
+
+#endif // K_RESIZE_RGB24_H
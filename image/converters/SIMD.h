@@ -0,0 +1,63 @@
+#ifndef K_SIMD_H
+#define K_SIMD_H
+
+/**
+ * runtime detection of the CPU's SIMD capabilities.
+ *
+ * the SIMD kernels are compiled with per-function target attributes,
+ * so the library itself does not need to be built with -mavx2 etc.
+ * the best supported kernel is selected at runtime (cpuid).
+ *
+ * define K_NO_SIMD to only use the (bit-exact) scalar converters.
+ */
+
+#if !defined(K_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define K_SIMD_X86
+	#include <immintrin.h>
+	#define K_TARGET(x) __attribute__((target(x)))
+#endif
+
+namespace K {
+
+	/** the supported SIMD instruction sets. ordered from worst to best */
+	enum class SIMDLevel {
+		SCALAR,
+		SSE2,
+		SSSE3,
+		AVX2,
+	};
+
+	/** the best SIMD level supported by this CPU */
+	static SIMDLevel detectSIMDLevel() {
+		#ifdef K_SIMD_X86
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2"))		{return SIMDLevel::AVX2;}
+			if (__builtin_cpu_supports("ssse3"))	{return SIMDLevel::SSSE3;}
+			if (__builtin_cpu_supports("sse2"))		{return SIMDLevel::SSE2;}
+		#endif
+		return SIMDLevel::SCALAR;
+	}
+
+	/** the SIMD level used by all converters (detected once) */
+	static inline SIMDLevel& _simdLevel() {
+		static SIMDLevel level = detectSIMDLevel();
+		return level;
+	}
+
+	/** get the SIMD level used by all converters */
+	static inline SIMDLevel getSIMDLevel() {
+		return _simdLevel();
+	}
+
+	/**
+	 * limit the SIMD level used by all converters (e.g. to compare against the scalar path).
+	 * levels the CPU does not support are ignored
+	 */
+	static inline void setSIMDLevel(const SIMDLevel level) {
+		const SIMDLevel supported = detectSIMDLevel();
+		_simdLevel() = (level < supported) ? (level) : (supported);
+	}
+
+}
+
+#endif // K_SIMD_H
@@ -2,14 +2,167 @@
 #define K_YUV420_RGB24_H
 
 #include "YUV.h"
+#include "YUV_SIMD.h"
 #include "../WebcamImage.h"
+#include "../ThreadPool.h"
 
 namespace K {
 
-	/** convert YUV420 -> RGB24 */
-	static void convertYUV420toRGB24(const WebcamImage& src, WebcamImage& dst) {
+	/**
+	 * convert pixels [x0, w) of a pair of YUV420 rows sharing the same chroma row to RGB24.
+	 * y1/dst1 are nullptr for the last row of images with odd height
+	 */
+	static void convertYUV420toRGB24RowPairScalar(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v,
+												  uint8_t* dst0, uint8_t* dst1, const uint32_t x0, const uint32_t w) {
+
+		for (uint32_t x = x0; x < w; ++x) {
+			const uint8_t _u = u[x/2];
+			const uint8_t _v = v[x/2];
+			YUVtoRGB(y0[x], _u, _v, dst0[x*3+0], dst0[x*3+1], dst0[x*3+2]);
+			if (y1) {YUVtoRGB(y1[x], _u, _v, dst1[x*3+0], dst1[x*3+1], dst1[x*3+2]);}
+		}
+
+	}
+
+#ifdef K_SIMD_X86
+
+	/** convert 16 pixels of two rows per iteration. returns the number of converted pixels (per row) */
+	K_TARGET("sse2")
+	static uint32_t convertYUV420toRGB24RowPairSSE2(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v,
+													uint8_t* dst0, uint8_t* dst1, const uint32_t w) {
+
+		const __m128i zero = _mm_setzero_si128();
+		uint32_t x = 0;
+
+		for (; x + 16 <= w; x += 16) {
+
+			// chroma for 8 pixel-pairs, calculated once for both rows: U0 V0 U1 V1 ...
+			const __m128i uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (u + x/2)), _mm_loadl_epi64((const __m128i*) (v + x/2)));
+			const YUVChromaSSE2 c0 = YUVChroma_SSE2(_mm_unpacklo_epi8(uv, zero));
+			const YUVChromaSSE2 c1 = YUVChroma_SSE2(_mm_unpackhi_epi8(uv, zero));
+
+			for (int row = 0; row < 2; ++row) {
+
+				const uint8_t* yRow = (row == 0) ? (y0) : (y1);
+				uint8_t* dstRow = (row == 0) ? (dst0) : (dst1);
+				if (!yRow) {break;}
+
+				const __m128i yy = _mm_loadu_si128((const __m128i*) (yRow + x));
+				__m128i r0, g0, b0, r1, g1, b1;
+				YUVtoRGB_SSE2(_mm_unpacklo_epi8(yy, zero), c0, r0, g0, b0);
+				YUVtoRGB_SSE2(_mm_unpackhi_epi8(yy, zero), c1, r1, g1, b1);
+
+				storeRGB24_SSE2(dstRow + x*3, _mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1), _mm_packus_epi16(b0, b1));
+
+			}
+
+		}
 
-		debug("ImageConverter", "converting YUV420 -> RGB24");
+		return x;
+
+	}
+
+	/** convert 16 pixels of two rows per iteration. returns the number of converted pixels (per row) */
+	K_TARGET("ssse3")
+	static uint32_t convertYUV420toRGB24RowPairSSSE3(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v,
+												   uint8_t* dst0, uint8_t* dst1, const uint32_t w) {
+
+		const __m128i zero = _mm_setzero_si128();
+		uint32_t x = 0;
+
+		for (; x + 16 <= w; x += 16) {
+
+			// chroma for 8 pixel-pairs, calculated once for both rows: U0 V0 U1 V1 ...
+			const __m128i uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (u + x/2)), _mm_loadl_epi64((const __m128i*) (v + x/2)));
+			const YUVChromaSSE2 c0 = YUVChroma_SSE2(_mm_unpacklo_epi8(uv, zero));
+			const YUVChromaSSE2 c1 = YUVChroma_SSE2(_mm_unpackhi_epi8(uv, zero));
+
+			for (int row = 0; row < 2; ++row) {
+
+				const uint8_t* yRow = (row == 0) ? (y0) : (y1);
+				uint8_t* dstRow = (row == 0) ? (dst0) : (dst1);
+				if (!yRow) {break;}
+
+				const __m128i yy = _mm_loadu_si128((const __m128i*) (yRow + x));
+				__m128i r0, g0, b0, r1, g1, b1;
+				YUVtoRGB_SSE2(_mm_unpacklo_epi8(yy, zero), c0, r0, g0, b0);
+				YUVtoRGB_SSE2(_mm_unpackhi_epi8(yy, zero), c1, r1, g1, b1);
+
+				storeRGB24_SSSE3(dstRow + x*3, _mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1), _mm_packus_epi16(b0, b1));
+
+			}
+
+		}
+
+		return x;
+
+	}
+
+	/** convert 32 pixels of two rows per iteration. returns the number of converted pixels (per row) */
+	K_TARGET("avx2")
+	static uint32_t convertYUV420toRGB24RowPairAVX2(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v,
+													uint8_t* dst0, uint8_t* dst1, const uint32_t w) {
+
+		uint32_t x = 0;
+
+		for (; x + 32 <= w; x += 32) {
+
+			// chroma for 16 pixel-pairs, calculated once for both rows: U0 V0 U1 V1 ...
+			const __m128i u16 = _mm_loadu_si128((const __m128i*) (u + x/2));
+			const __m128i v16 = _mm_loadu_si128((const __m128i*) (v + x/2));
+			const YUVChromaAVX2 c0 = YUVChroma_AVX2(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u16, v16)));	// pixels 0-15
+			const YUVChromaAVX2 c1 = YUVChroma_AVX2(_mm256_cvtepu8_epi16(_mm_unpackhi_epi8(u16, v16)));	// pixels 16-31
+
+			for (int row = 0; row < 2; ++row) {
+
+				const uint8_t* yRow = (row == 0) ? (y0) : (y1);
+				uint8_t* dstRow = (row == 0) ? (dst0) : (dst1);
+				if (!yRow) {break;}
+
+				__m256i r0, g0, b0, r1, g1, b1;
+				YUVtoRGB_AVX2(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (yRow + x +  0))), c0, r0, g0, b0);
+				YUVtoRGB_AVX2(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (yRow + x + 16))), c1, r1, g1, b1);
+
+				storeRGB24_AVX2(dstRow + x*3, packPixels_AVX2(r0, r1), packPixels_AVX2(g0, g1), packPixels_AVX2(b0, b1));
+
+			}
+
+		}
+
+		return x;
+
+	}
+
+#endif
+
+	/**
+	 * convert a pair of YUV420 rows (sharing the same chroma row) with w pixels to RGB24,
+	 * using the best available kernel.
+	 * y1/dst1 are nullptr for the last row of images with odd height
+	 */
+	static void convertYUV420toRGB24RowPair(const uint8_t* y0, const uint8_t* y1, const uint8_t* u, const uint8_t* v,
+											uint8_t* dst0, uint8_t* dst1, const uint32_t w) {
+
+		uint32_t x = 0;
+
+		#ifdef K_SIMD_X86
+		switch (getSIMDLevel()) {
+			case SIMDLevel::AVX2:	x = convertYUV420toRGB24RowPairAVX2(y0, y1, u, v, dst0, dst1, w); break;
+			case SIMDLevel::SSSE3:	x = convertYUV420toRGB24RowPairSSSE3(y0, y1, u, v, dst0, dst1, w); break;
+			case SIMDLevel::SSE2:	x = convertYUV420toRGB24RowPairSSE2(y0, y1, u, v, dst0, dst1, w); break;
+			case SIMDLevel::SCALAR:	break;
+		}
+		#endif
+
+		// remaining pixels
+		convertYUV420toRGB24RowPairScalar(y0, y1, u, v, dst0, dst1, x, w);
+
+	}
+
+	/** convert YUV420 -> RGB24. the optional pool converts several stripes of rows in parallel */
+	static void convertYUV420toRGB24(const WebcamImage& src, WebcamImage& dst, ThreadPool* pool = nullptr) {
+
+		debugVerbose("ImageConverter", "converting YUV420 -> RGB24");
 
 		const uint32_t w = src.getWidth();
 		const uint32_t h = src.getHeight();
@@ -19,26 +172,25 @@ namespace K {
 		uint8_t* dstBuffer = dst.getData();
 
 		// calculate U and V offset within srcData
-		const uint32_t offsetU = (w*h);					// start of U part
-		const uint32_t offsetV = (w*h) + (w*h/4);			// start of V part
-
-		// translate each pixel
-		for (uint32_t y = 0; y < h; ++y) {
-			for (uint32_t x = 0; x < w; ++x) {
-
-				const uint32_t offsetY = (y*w + x);
-				const uint32_t offsetUV = (y/2*w/2 + x/2);
-
-				// get Y,U,V values
-				const int32_t _y =	srcBuffer[ offsetY ];
-				const int32_t _u =	srcBuffer[ offsetU + offsetUV ];
-				const int32_t _v =	srcBuffer[ offsetV + offsetUV ];
-
-				// convert
-				YUVtoRGB(_y, _u, _v,   dstBuffer[offsetY*3+0], dstBuffer[offsetY*3+0], dstBuffer[offsetY*3+2] );
+		const uint32_t cw = (w+1) / 2;						// width of the chroma planes
+		const uint32_t ch = (h+1) / 2;						// height of the chroma planes
+		const uint8_t* srcU = srcBuffer + (w*h);			// start of U part
+		const uint8_t* srcV = srcU + (cw*ch);				// start of V part
+
+		// translate each pair of rows (sharing the same chroma row). stripes must not split a pair
+		forEachStripe(pool, h, 2, [&] (const uint32_t y0, const uint32_t y1) {
+			for (uint32_t y = y0; y < y1; y += 2) {
+
+				const bool pair = (y + 1) < h;
+				convertYUV420toRGB24RowPair(
+					srcBuffer + y*w,		(pair) ? (srcBuffer + (y+1)*w) : (nullptr),
+					srcU + (y/2)*cw,		srcV + (y/2)*cw,
+					dstBuffer + y*w*3,		(pair) ? (dstBuffer + (y+1)*w*3) : (nullptr),
+					w
+				);
 
 			}
-		}
+		});
 
 		// set
 		dst.setParameters( src.getWidth(), src.getHeight(), PixelFormat(V4L2_PIX_FMT_RGB24), (w*h*3) );
@@ -2,13 +2,14 @@
 #define K_YUV420_YUV24_H
 
 #include "../WebcamImage.h"
+#include "../ThreadPool.h"
 
 namespace K {
 
 	/** convert YUV420 -> YUV24 */
-	static void convertYUV420toYUV24(const WebcamImage& src, WebcamImage& dst) {
+	static void convertYUV420toYUV24(const WebcamImage& src, WebcamImage& dst, ThreadPool* pool = nullptr) {
 
-		debug("ImageConverter", "converting YUV420 -> YUV24");
+		debugVerbose("ImageConverter", "converting YUV420 -> YUV24");
 
 		const uint32_t w = src.getWidth();
 		const uint32_t h = src.getHeight();
@@ -22,19 +23,21 @@ namespace K {
 		const uint32_t offsetV = (w*h) + (w*h/4);		// start of V part
 
 		// translate each pixel
-		for (uint32_t y = 0; y < h; ++y) {
-			for (uint32_t x = 0; x < w; ++x) {
+		forEachStripe(pool, h, 1, [&] (const uint32_t y0, const uint32_t y1) {
+			for (uint32_t y = y0; y < y1; ++y) {
+				for (uint32_t x = 0; x < w; ++x) {
 
-				const uint32_t offsetY = (y*w + x);
-				const uint32_t offsetUV = (y/2*w/2 + x/2);
+					const uint32_t offsetY = (y*w + x);
+					const uint32_t offsetUV = (y/2*w/2 + x/2);
 
-				// interleave and stretch U/V
-				dstBuffer[ offsetY*3 + 0 ] = srcBuffer[ offsetY ];
-				dstBuffer[ offsetY*3 + 1 ] = srcBuffer[ offsetU + offsetUV ];
-				dstBuffer[ offsetY*3 + 2 ] = srcBuffer[ offsetV + offsetUV ];
+					// interleave and stretch U/V
+					dstBuffer[ offsetY*3 + 0 ] = srcBuffer[ offsetY ];
+					dstBuffer[ offsetY*3 + 1 ] = srcBuffer[ offsetU + offsetUV ];
+					dstBuffer[ offsetY*3 + 2 ] = srcBuffer[ offsetV + offsetUV ];
 
+				}
 			}
-		}
+		});
 
 		// set
 		dst.setParameters( src.getWidth(), src.getHeight(), PixelFormat(V4L2_PIX_FMT_YUV420), (w*h*3) );
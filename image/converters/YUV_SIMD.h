@@ -0,0 +1,180 @@
+#ifndef K_YUV_SIMD_H
+#define K_YUV_SIMD_H
+
+/**
+ * SIMD versions of YUVtoRGB() (see YUV.h).
+ *
+ * all kernels use 32-bit intermediates and the very same rounding
+ * and clamping (by saturation) as the scalar code and thus are bit-exact.
+ *
+ * input:	y	the luma of 8 (16) pixels as 16-bit words
+ *			uv	the chroma of the 4 (8) pixel-pairs as 16-bit words: U0 V0 U1 V1 ...
+ *				(or their precomputed chroma part, to reuse it for several rows)
+ * output:	r,g,b as 16-bit words, one per pixel
+ */
+
+#include <stdint.h>
+#include "SIMD.h"
+
+#ifdef K_SIMD_X86
+
+namespace K {
+
+	/** multiplier pair for _mm_madd_epi16() on (U,V) words */
+	#define K_UV_MUL(mu, mv)	((int32_t) (((uint32_t) (uint16_t) (mv) << 16) | (uint16_t) (mu)))
+
+	/** precomputed chroma part (+ rounding) for 4 pixel-pairs [32 bit each] */
+	struct YUVChromaSSE2 {
+		__m128i r, g, b;
+	};
+
+	/** precomputed chroma part (+ rounding) for 8 pixel-pairs [32 bit each] */
+	struct YUVChromaAVX2 {
+		__m256i r, g, b;
+	};
+
+	/** calculate the chroma part of 4 pixel-pairs (SSE2) */
+	K_TARGET("sse2")
+	static inline YUVChromaSSE2 YUVChroma_SSE2(const __m128i uv) {
+		const __m128i de = _mm_sub_epi16(uv, _mm_set1_epi16(128));
+		const __m128i round = _mm_set1_epi32(128);
+		YUVChromaSSE2 c;
+		c.r = _mm_add_epi32(_mm_madd_epi16(de, _mm_set1_epi32(K_UV_MUL(0, 409))), round);
+		c.g = _mm_add_epi32(_mm_madd_epi16(de, _mm_set1_epi32(K_UV_MUL(-100, -208))), round);
+		c.b = _mm_add_epi32(_mm_madd_epi16(de, _mm_set1_epi32(K_UV_MUL(516, 0))), round);
+		return c;
+	}
+
+	/** combine the luma of 8 pixels with the chroma of their 4 pixel-pairs (SSE2) */
+	K_TARGET("sse2")
+	static inline void YUVtoRGB_SSE2(const __m128i y, const YUVChromaSSE2& ch, __m128i& r, __m128i& g, __m128i& b) {
+
+		// luma part for each pixel [32 bit]
+		const __m128i c = _mm_sub_epi16(y, _mm_set1_epi16(16));
+		const __m128i mul = _mm_set1_epi16(298);
+		const __m128i lo = _mm_mullo_epi16(c, mul);
+		const __m128i hi = _mm_mulhi_epi16(c, mul);
+		const __m128i l0 = _mm_unpacklo_epi16(lo, hi);		// pixels 0-3
+		const __m128i l1 = _mm_unpackhi_epi16(lo, hi);		// pixels 4-7
+
+		// combine (each pixel-pair's chroma is used for two pixels) and shift
+		#define K_COMBINE(cx) _mm_packs_epi32(\
+			_mm_srai_epi32(_mm_add_epi32(l0, _mm_unpacklo_epi32(cx, cx)), 8),\
+			_mm_srai_epi32(_mm_add_epi32(l1, _mm_unpackhi_epi32(cx, cx)), 8))
+		r = K_COMBINE(ch.r);
+		g = K_COMBINE(ch.g);
+		b = K_COMBINE(ch.b);
+		#undef K_COMBINE
+
+	}
+
+	/** convert 8 pixels (SSE2) */
+	K_TARGET("sse2")
+	static inline void YUVtoRGB_SSE2(const __m128i y, const __m128i uv, __m128i& r, __m128i& g, __m128i& b) {
+		YUVtoRGB_SSE2(y, YUVChroma_SSE2(uv), r, g, b);
+	}
+
+	/** calculate the chroma part of 8 pixel-pairs (AVX2). each 128-bit lane holds 4 pairs */
+	K_TARGET("avx2")
+	static inline YUVChromaAVX2 YUVChroma_AVX2(const __m256i uv) {
+		const __m256i de = _mm256_sub_epi16(uv, _mm256_set1_epi16(128));
+		const __m256i round = _mm256_set1_epi32(128);
+		YUVChromaAVX2 c;
+		c.r = _mm256_add_epi32(_mm256_madd_epi16(de, _mm256_set1_epi32(K_UV_MUL(0, 409))), round);
+		c.g = _mm256_add_epi32(_mm256_madd_epi16(de, _mm256_set1_epi32(K_UV_MUL(-100, -208))), round);
+		c.b = _mm256_add_epi32(_mm256_madd_epi16(de, _mm256_set1_epi32(K_UV_MUL(516, 0))), round);
+		return c;
+	}
+
+	/** combine the luma of 16 pixels with the chroma of their 8 pixel-pairs (AVX2). each 128-bit lane holds 8 pixels */
+	K_TARGET("avx2")
+	static inline void YUVtoRGB_AVX2(const __m256i y, const YUVChromaAVX2& ch, __m256i& r, __m256i& g, __m256i& b) {
+
+		// luma part for each pixel [32 bit]
+		const __m256i c = _mm256_sub_epi16(y, _mm256_set1_epi16(16));
+		const __m256i mul = _mm256_set1_epi16(298);
+		const __m256i lo = _mm256_mullo_epi16(c, mul);
+		const __m256i hi = _mm256_mulhi_epi16(c, mul);
+		const __m256i l0 = _mm256_unpacklo_epi16(lo, hi);
+		const __m256i l1 = _mm256_unpackhi_epi16(lo, hi);
+
+		// combine (each pixel-pair's chroma is used for two pixels) and shift
+		#define K_COMBINE(cx) _mm256_packs_epi32(\
+			_mm256_srai_epi32(_mm256_add_epi32(l0, _mm256_unpacklo_epi32(cx, cx)), 8),\
+			_mm256_srai_epi32(_mm256_add_epi32(l1, _mm256_unpackhi_epi32(cx, cx)), 8))
+		r = K_COMBINE(ch.r);
+		g = K_COMBINE(ch.g);
+		b = K_COMBINE(ch.b);
+		#undef K_COMBINE
+
+	}
+
+	/** convert 16 pixels (AVX2). each 128-bit lane holds 8 pixels */
+	K_TARGET("avx2")
+	static inline void YUVtoRGB_AVX2(const __m256i y, const __m256i uv, __m256i& r, __m256i& g, __m256i& b) {
+		YUVtoRGB_AVX2(y, YUVChroma_AVX2(uv), r, g, b);
+	}
+
+	#undef K_UV_MUL
+
+
+	/** interleave 16 R, G and B bytes into 48 bytes RGB24 (SSE2 has no shuffle -> scalar) */
+	K_TARGET("sse2")
+	static inline void storeRGB24_SSE2(uint8_t* dst, const __m128i r, const __m128i g, const __m128i b) {
+		alignas(16) uint8_t _r[16], _g[16], _b[16];
+		_mm_store_si128((__m128i*) _r, r);
+		_mm_store_si128((__m128i*) _g, g);
+		_mm_store_si128((__m128i*) _b, b);
+		for (int i = 0; i < 16; ++i) {
+			dst[i*3+0] = _r[i];
+			dst[i*3+1] = _g[i];
+			dst[i*3+2] = _b[i];
+		}
+	}
+
+	/** interleave 16 R, G and B bytes into 48 bytes RGB24 */
+	K_TARGET("ssse3")
+	static inline void storeRGB24_SSSE3(uint8_t* dst, const __m128i r, const __m128i g, const __m128i b) {
+
+		const __m128i r0 = _mm_setr_epi8(0,-128,-128,1,-128,-128,2,-128,-128,3,-128,-128,4,-128,-128,5);
+		const __m128i g0 = _mm_setr_epi8(-128,0,-128,-128,1,-128,-128,2,-128,-128,3,-128,-128,4,-128,-128);
+		const __m128i b0 = _mm_setr_epi8(-128,-128,0,-128,-128,1,-128,-128,2,-128,-128,3,-128,-128,4,-128);
+
+		const __m128i r1 = _mm_setr_epi8(-128,-128,6,-128,-128,7,-128,-128,8,-128,-128,9,-128,-128,10,-128);
+		const __m128i g1 = _mm_setr_epi8(5,-128,-128,6,-128,-128,7,-128,-128,8,-128,-128,9,-128,-128,10);
+		const __m128i b1 = _mm_setr_epi8(-128,5,-128,-128,6,-128,-128,7,-128,-128,8,-128,-128,9,-128,-128);
+
+		const __m128i r2 = _mm_setr_epi8(-128,11,-128,-128,12,-128,-128,13,-128,-128,14,-128,-128,15,-128,-128);
+		const __m128i g2 = _mm_setr_epi8(-128,-128,11,-128,-128,12,-128,-128,13,-128,-128,14,-128,-128,15,-128);
+		const __m128i b2 = _mm_setr_epi8(10,-128,-128,11,-128,-128,12,-128,-128,13,-128,-128,14,-128,-128,15);
+
+		#define K_MERGE(mr, mg, mb) _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, mr), _mm_shuffle_epi8(g, mg)), _mm_shuffle_epi8(b, mb))
+		_mm_storeu_si128((__m128i*) (dst +  0), K_MERGE(r0, g0, b0));
+		_mm_storeu_si128((__m128i*) (dst + 16), K_MERGE(r1, g1, b1));
+		_mm_storeu_si128((__m128i*) (dst + 32), K_MERGE(r2, g2, b2));
+		#undef K_MERGE
+
+	}
+
+	/** interleave 32 R, G and B bytes into 96 bytes RGB24 */
+	K_TARGET("avx2")
+	static inline void storeRGB24_AVX2(uint8_t* dst, const __m256i r, const __m256i g, const __m256i b) {
+		storeRGB24_SSSE3(dst +  0, _mm256_castsi256_si128(r), _mm256_castsi256_si128(g), _mm256_castsi256_si128(b));
+		storeRGB24_SSSE3(dst + 48, _mm256_extracti128_si256(r, 1), _mm256_extracti128_si256(g, 1), _mm256_extracti128_si256(b, 1));
+	}
+
+	/**
+	 * saturate two vectors of 16 pixels (16-bit words, see YUVtoRGB_AVX2())
+	 * into 32 bytes in pixel order
+	 */
+	K_TARGET("avx2")
+	static inline __m256i packPixels_AVX2(const __m256i a, const __m256i b) {
+		// packus works per 128-bit lane -> restore the order of the 64-bit quarters
+		return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+	}
+
+}
+
+#endif // K_SIMD_X86
+
+#endif // K_YUV_SIMD_H
@@ -9,38 +9,141 @@
 #define K_YUYV_RGB24_H_
 
 #include "YUV.h"
+#include "YUV_SIMD.h"
 #include "../WebcamImage.h"
+#include "../ThreadPool.h"
 
 namespace K {
 
-	/** convert YUYV (YUV422) to RGB24 */
-	static void convertYUYVtoRGB24(const WebcamImage& src, WebcamImage& dst) {
+	/** convert pixels [x0, w) of one YUYV (YUV422) row to RGB24 */
+	static void convertYUYVtoRGB24RowScalar(const uint8_t* srcRow, uint8_t* dstRow, const uint32_t x0, const uint32_t w) {
 
-		const uint32_t w = src.getWidth();
-		const uint32_t h = src.getHeight();
+		for (uint32_t x = x0; x < w; ++x) {
 
-		const uint8_t* srcBuffer = src.getData();
-		dst.ensureSpace(w*h*3);
-		uint8_t* dstBuffer = dst.getData();
+			const uint8_t Y  = srcRow[x*2+0];
+			const uint8_t Cb = srcRow[x/2*4+1];
+			const uint8_t Cr = srcRow[x/2*4+3];
+
+			YUVtoRGB(Y, Cb, Cr, dstRow[x*3+0], dstRow[x*3+1], dstRow[x*3+2]);
+
+		}
+
+	}
 
-		// calculate U and V offset within srcData
-		//uint32_t offsetU = (w*h);					// start of U part
-		//uint32_t offsetV = (w*h) + (w*h/4);			// start of V part
+#ifdef K_SIMD_X86
 
-		// translate each pixel
-		for (uint32_t y = 0; y < h; ++y) {
-			for (uint32_t x = 0; x < w; ++x) {
+	/** convert 16 pixels per iteration. returns the number of converted pixels */
+	K_TARGET("sse2")
+	static uint32_t convertYUYVtoRGB24RowSSE2(const uint8_t* srcRow, uint8_t* dstRow, const uint32_t w) {
 
-				const uint8_t Y  = srcBuffer[(x     + y*w)*2+0];
-				const uint8_t Cb = srcBuffer[(x/2*4 + y*w*2)+1];
-				const uint8_t Cr = srcBuffer[(x/2*4 + y*w*2)+3];
+		const __m128i maskY = _mm_set1_epi16(0x00FF);
+		uint32_t x = 0;
 
-				int rgbIDX = (x+y*w)*3;
+		for (; x + 16 <= w; x += 16) {
 
-				YUVtoRGB(Y, Cb, Cr, dstBuffer[rgbIDX+0], dstBuffer[rgbIDX+1], dstBuffer[rgbIDX+2]);
+			// 2x 8 pixels: Y0 U0 Y1 V0 Y2 U1 Y3 V1 ...
+			const __m128i a = _mm_loadu_si128((const __m128i*) (srcRow + x*2 +  0));
+			const __m128i b = _mm_loadu_si128((const __m128i*) (srcRow + x*2 + 16));
 
-			}
+			__m128i ra, ga, ba, rb, gb, bb;
+			YUVtoRGB_SSE2(_mm_and_si128(a, maskY), _mm_srli_epi16(a, 8), ra, ga, ba);
+			YUVtoRGB_SSE2(_mm_and_si128(b, maskY), _mm_srli_epi16(b, 8), rb, gb, bb);
+
+			storeRGB24_SSE2(dstRow + x*3, _mm_packus_epi16(ra, rb), _mm_packus_epi16(ga, gb), _mm_packus_epi16(ba, bb));
+
+		}
+
+		return x;
+
+	}
+
+	/** convert 16 pixels per iteration. returns the number of converted pixels */
+	K_TARGET("ssse3")
+	static uint32_t convertYUYVtoRGB24RowSSSE3(const uint8_t* srcRow, uint8_t* dstRow, const uint32_t w) {
+
+		const __m128i maskY = _mm_set1_epi16(0x00FF);
+		uint32_t x = 0;
+
+		for (; x + 16 <= w; x += 16) {
+
+			// 2x 8 pixels: Y0 U0 Y1 V0 Y2 U1 Y3 V1 ...
+			const __m128i a = _mm_loadu_si128((const __m128i*) (srcRow + x*2 +  0));
+			const __m128i b = _mm_loadu_si128((const __m128i*) (srcRow + x*2 + 16));
+
+			__m128i ra, ga, ba, rb, gb, bb;
+			YUVtoRGB_SSE2(_mm_and_si128(a, maskY), _mm_srli_epi16(a, 8), ra, ga, ba);
+			YUVtoRGB_SSE2(_mm_and_si128(b, maskY), _mm_srli_epi16(b, 8), rb, gb, bb);
+
+			storeRGB24_SSSE3(dstRow + x*3, _mm_packus_epi16(ra, rb), _mm_packus_epi16(ga, gb), _mm_packus_epi16(ba, bb));
+
+		}
+
+		return x;
+
+	}
+
+	/** convert 32 pixels per iteration. returns the number of converted pixels */
+	K_TARGET("avx2")
+	static uint32_t convertYUYVtoRGB24RowAVX2(const uint8_t* srcRow, uint8_t* dstRow, const uint32_t w) {
+
+		const __m256i maskY = _mm256_set1_epi16(0x00FF);
+		uint32_t x = 0;
+
+		for (; x + 32 <= w; x += 32) {
+
+			// 2x 16 pixels: Y0 U0 Y1 V0 Y2 U1 Y3 V1 ...
+			const __m256i a = _mm256_loadu_si256((const __m256i*) (srcRow + x*2 +  0));
+			const __m256i b = _mm256_loadu_si256((const __m256i*) (srcRow + x*2 + 32));
+
+			__m256i ra, ga, ba, rb, gb, bb;
+			YUVtoRGB_AVX2(_mm256_and_si256(a, maskY), _mm256_srli_epi16(a, 8), ra, ga, ba);
+			YUVtoRGB_AVX2(_mm256_and_si256(b, maskY), _mm256_srli_epi16(b, 8), rb, gb, bb);
+
+			storeRGB24_AVX2(dstRow + x*3, packPixels_AVX2(ra, rb), packPixels_AVX2(ga, gb), packPixels_AVX2(ba, bb));
+
+		}
+
+		return x;
+
+	}
+
+#endif
+
+	/** convert one YUYV (YUV422) row with w pixels to RGB24, using the best available kernel */
+	static void convertYUYVtoRGB24Row(const uint8_t* srcRow, uint8_t* dstRow, const uint32_t w) {
+
+		uint32_t x = 0;
+
+		#ifdef K_SIMD_X86
+		switch (getSIMDLevel()) {
+			case SIMDLevel::AVX2:	x = convertYUYVtoRGB24RowAVX2(srcRow, dstRow, w); break;
+			case SIMDLevel::SSSE3:	x = convertYUYVtoRGB24RowSSSE3(srcRow, dstRow, w); break;
+			case SIMDLevel::SSE2:	x = convertYUYVtoRGB24RowSSE2(srcRow, dstRow, w); break;
+			case SIMDLevel::SCALAR:	break;
 		}
+		#endif
+
+		// remaining pixels
+		convertYUYVtoRGB24RowScalar(srcRow, dstRow, x, w);
+
+	}
+
+	/** convert YUYV (YUV422) to RGB24. the optional pool converts several stripes of rows in parallel */
+	static void convertYUYVtoRGB24(const WebcamImage& src, WebcamImage& dst, ThreadPool* pool = nullptr) {
+
+		const uint32_t w = src.getWidth();
+		const uint32_t h = src.getHeight();
+
+		const uint8_t* srcBuffer = src.getData();
+		dst.ensureSpace(w*h*3);
+		uint8_t* dstBuffer = dst.getData();
+
+		// translate each row
+		forEachStripe(pool, h, 1, [&] (const uint32_t y0, const uint32_t y1) {
+			for (uint32_t y = y0; y < y1; ++y) {
+				convertYUYVtoRGB24Row(srcBuffer + y*w*2, dstBuffer + y*w*3, w);
+			}
+		});
 
 		// set
 		dst.setParameters( src.getWidth(), src.getHeight(), PixelFormat(V4L2_PIX_FMT_RGB24), (w*h*3) );
@@ -2,13 +2,14 @@
 #define K_YXX_RGB24_H
 
 #include "../WebcamImage.h"
+#include "../ThreadPool.h"
 
 namespace K {
 
 	/** convert from Yxx (xx-bit grey-scale) to RGB24 */
-	static void convertYxxToRGB24(const int numBits, const WebcamImage& src, WebcamImage& dst) {
+	static void convertYxxToRGB24(const int numBits, const WebcamImage& src, WebcamImage& dst, ThreadPool* pool = nullptr) {
 
-		debug("ImageConverter", "converting Y" << numBits << " -> RGB24");
+		debugVerbose("ImageConverter", "converting Y" << numBits << " -> RGB24");
 
 		const uint32_t w = src.getWidth();
 		const uint32_t h = src.getHeight();
@@ -18,24 +19,26 @@ namespace K {
 		uint8_t* dstBuffer = dst.getData();
 
 		// translate each pixel
-		for (uint32_t y = 0; y < h; ++y) {
-			for (uint32_t x = 0; x < w; ++x) {
+		forEachStripe(pool, h, 1, [&] (const uint32_t y0, const uint32_t y1) {
+			for (uint32_t y = y0; y < y1; ++y) {
+				for (uint32_t x = 0; x < w; ++x) {
 
-				const uint32_t srcIdx = (x + y*w) * 2;
-				const uint32_t dstIdx = (x + y*w) * 3;
+					const uint32_t srcIdx = (x + y*w) * 2;
+					const uint32_t dstIdx = (x + y*w) * 3;
 
-				// 16 bit src value (highest bits are unused)
-				const uint16_t g16 = ((uint16_t)srcBuffer[srcIdx+0] << 0) | ((uint16_t)srcBuffer[srcIdx+1] << 8);
+					// 16 bit src value (highest bits are unused)
+					const uint16_t g16 = ((uint16_t)srcBuffer[srcIdx+0] << 0) | ((uint16_t)srcBuffer[srcIdx+1] << 8);
 
-				// convert to 8 bit grey
-				const uint8_t  g8 = g16 >> (numBits - 8);
+					// convert to 8 bit grey
+					const uint8_t  g8 = g16 >> (numBits - 8);
 
-				dstBuffer[ dstIdx + 0 ] = g8;
-				dstBuffer[ dstIdx + 1 ] = g8;
-				dstBuffer[ dstIdx + 2 ] = g8;
+					dstBuffer[ dstIdx + 0 ] = g8;
+					dstBuffer[ dstIdx + 1 ] = g8;
+					dstBuffer[ dstIdx + 2 ] = g8;
 
+				}
 			}
-		}
+		});
 
 		// set
 		dst.setParameters( src.getWidth(), src.getHeight(), PixelFormat(V4L2_PIX_FMT_RGB24), (w*h*3) );
@@ -0,0 +1,200 @@
+#ifndef K_CAPTUREREACTOR_H
+#define K_CAPTUREREACTOR_H
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Webcam.h"
+#include "WebcamException.h"
+
+namespace K {
+
+	/**
+	 * captures from many webcams using only one thread.
+	 *
+	 * all registered webcams' file-descriptors are watched by a single
+	 * epoll instance. whenever one of the webcams has an image ready,
+	 * it is read (without blocking) and handed to this webcam's callback.
+	 * works with every WebcamIO (MMAP, R/W, ...) as long as the device
+	 * supports poll().
+	 *
+	 * the images passed to the callbacks are volatile (see Webcam::readImage())
+	 * and must be processed or copied before the callback returns.
+	 * exceptions thrown while reading (or by the callbacks) leave poll()/run().
+	 *
+	 * usage:
+	 *	cam1.open ... cam1.start, cam2.open ... cam2.start
+	 *	reactor.add(cam1, [] (Webcam& cam, WebcamImage& img) {...});
+	 *	reactor.add(cam2, [] (Webcam& cam, WebcamImage& img) {...});
+	 *	reactor.run();		// until reactor.stop() is called (from any thread)
+	 *	reactor.reset();	// before using run() again
+	 *
+	 */
+	class CaptureReactor {
+
+	public:
+
+		/** called for every image captured by one of the webcams */
+		typedef std::function<void(Webcam& cam, WebcamImage& img)> Callback;
+
+		/** ctor */
+		CaptureReactor() : epfd(-1), wakeFD(-1), running(true) {
+
+			epfd = epoll_create1(EPOLL_CLOEXEC);
+			if (epfd == -1) {throw WebcamException("error while creating epoll instance", "CaptureReactor", errno);}
+
+			// used to wake up epoll_wait() when stop() is called
+			wakeFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+			if (wakeFD == -1) {::close(epfd); throw WebcamException("error while creating eventfd", "CaptureReactor", errno);}
+
+			struct epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.ptr = nullptr;
+			if (epoll_ctl(epfd, EPOLL_CTL_ADD, wakeFD, &ev) == -1) {
+				::close(wakeFD); ::close(epfd);
+				throw WebcamException("error while watching eventfd", "CaptureReactor", errno);
+			}
+
+		}
+
+		/** dtor */
+		~CaptureReactor() {
+			::close(wakeFD);
+			::close(epfd);
+		}
+
+		/**
+		 * watch the given (already started) webcam and call the callback for each of its images.
+		 * the webcam must outlive its registration within this reactor
+		 */
+		void add(Webcam& cam, Callback callback) {
+
+			if (cam.getFD() < 0) {throw WebcamException("open() the webcam first!", cam.getDevice());}
+
+			std::unique_ptr<Entry> entry(new Entry(cam, callback));
+
+			struct epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.ptr = entry.get();
+			if (epoll_ctl(epfd, EPOLL_CTL_ADD, cam.getFD(), &ev) == -1) {
+				throw WebcamException("error while adding webcam to reactor", cam.getDevice(), errno);
+			}
+
+			entries.push_back(std::move(entry));
+
+		}
+
+		/** stop watching the given webcam. must not be called from within a callback */
+		void remove(Webcam& cam) {
+
+			for (auto it = entries.begin(); it != entries.end(); ++it) {
+				if (&(*it)->cam != &cam) {continue;}
+				epoll_ctl(epfd, EPOLL_CTL_DEL, cam.getFD(), nullptr);
+				entries.erase(it);
+				return;
+			}
+
+		}
+
+		/** get the number of watched webcams */
+		size_t getNumWebcams() const {return entries.size();}
+
+		/**
+		 * wait (at most timeoutMS) until at least one webcam has an image ready
+		 * and dispatch all ready images to their callbacks.
+		 * @param timeoutMS the max. time to wait in milliseconds. -1 = forever, 0 = do not wait
+		 * @return the number of dispatched images
+		 */
+		uint32_t poll(const int timeoutMS) {
+
+			struct epoll_event events[MAX_EVENTS];
+			const int num = epoll_wait(epfd, events, MAX_EVENTS, timeoutMS);
+			if (num == -1) {
+				if (errno == EINTR) {return 0;}
+				throw WebcamException("error while waiting for images", "CaptureReactor", errno);
+			}
+
+			uint32_t numDispatched = 0;
+			for (int i = 0; i < num; ++i) {
+
+				Entry* entry = (Entry*) events[i].data.ptr;
+
+				// wake-up by stop()
+				if (entry == nullptr) {
+					uint64_t val;
+					while (::read(wakeFD, &val, sizeof(val)) > 0) {;}
+					continue;
+				}
+
+				// the device signaled readiness -> must not block. (errors will throw)
+				WebcamImage* img = entry->cam.tryReadImage();
+				if (img == nullptr) {continue;}
+				entry->callback(entry->cam, *img);
+				++numDispatched;
+
+			}
+
+			return numDispatched;
+
+		}
+
+		/** dispatch images until stop() is called. returns immediately if stop() was already called (see reset()) */
+		void run() {
+			while (running) {poll(-1);}
+		}
+
+		/**
+		 * let run() return. may be called from any thread (or from within a callback),
+		 * also before run() was started
+		 */
+		void stop() {
+			running = false;
+			const uint64_t val = 1;
+			if (::write(wakeFD, &val, sizeof(val)) == -1) {;}
+		}
+
+		/** allow run() to be used again after stop(). must not be called while run() is running */
+		void reset() {
+			running = true;
+		}
+
+	private:
+
+		/** the max. number of events to fetch with one epoll_wait() */
+		static constexpr int MAX_EVENTS = 32;
+
+		/** one watched webcam */
+		struct Entry {
+			Webcam& cam;
+			Callback callback;
+			Entry(Webcam& cam, Callback callback) : cam(cam), callback(callback) {;}
+		};
+
+		/** the epoll instance watching all webcams */
+		int epfd;
+
+		/** eventfd to wake up a blocking poll() */
+		int wakeFD;
+
+		/** keep run() running? */
+		std::atomic<bool> running;
+
+		/** all watched webcams */
+		std::vector<std::unique_ptr<Entry>> entries;
+
+		/** hidden copy ctor */
+		CaptureReactor(const CaptureReactor&);
+
+		/** hidden assignment operator */
+		CaptureReactor& operator = (const CaptureReactor&);
+
+	};
+
+}
+
+#endif // K_CAPTUREREACTOR_H
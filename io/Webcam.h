@@ -10,12 +10,35 @@
 #include "WebcamIO.h"
 #include "WebcamIORW.h"
 #include "WebcamIOMMAP.h"
+#include "WebcamIOUserPtr.h"
+#include "WebcamIOReplay.h"
+#include "WebcamFrameLease.h"
 
 #include "../Debug.h"
 #include "WebcamException.h"
 
 namespace K {
 
+	/** the IO methods a Webcam can use for capturing */
+	enum class WebcamIOMethod {
+
+		/** use the best method the device supports (MMAP or R/W) */
+		AUTO,
+
+		/** memory-mapped driver buffers */
+		MMAP,
+
+		/** caller-owned buffers the driver writes into. falls back to MMAP if unsupported */
+		USERPTR,
+
+		/** read() from the device file */
+		RW,
+
+		/** frames from a recorded file instead of a device (see WebcamIOReplay). the device name is the file's name */
+		REPLAY,
+
+	};
+
 	/**
 	 * handles to interaction with a webcam device (e.g. "/dev/video0")
 	 * allows:
@@ -25,6 +48,10 @@ namespace K {
 	 * the retrieved images (their memory) belongs to this class.
 	 * retrieving the next image, overwrites the previous one! (only 1 buffer)
 	 *
+	 * alternatively, leaseImage() returns images pointing directly
+	 * into the driver's buffers (no copy) which stay valid until
+	 * the lease is released.
+	 *
 	 * usage:
 	 *	open
 	 *	setFormat
@@ -45,8 +72,10 @@ namespace K {
 		 * @param dev the linux device name (e.g. "/dev/video0") to open
 		 */
 		Webcam(const std::string& dev) :
-			dev(dev), io(0), fd(0), isOpen(false), isRunning(false), isInitialized(false) {
-			;
+			dev(dev), io(0), ioMethod(WebcamIOMethod::AUTO), numBuffers(0), latestOnly(false), replayFPS(-1),
+			fd(-1), isOpen(false), isRunning(false), isInitialized(false),
+			hasSequence(false), lastSequence(0), lastSkipped(0), numDropped(0), numErrors(0) {
+			CLEAR(fmt);		// no format (and max. image size) before setFormat()
 		}
 
 		/** dtor */
@@ -71,6 +100,9 @@ namespace K {
 
 			if (isOpen) {return;}
 
+			// no device at all: everything comes from the recording
+			if (ioMethod == WebcamIOMethod::REPLAY) {openReplay(); isOpen = true; return;}
+
 			// open a file-descriptor to the camera
 			debug(dev, "opening");
 			fd = ::open(dev.c_str(), O_RDWR | O_NONBLOCK, 0);
@@ -93,7 +125,9 @@ namespace K {
 		void init() {
 			if (isInitialized) {return;}
 			if (!isOpen) {throw WebcamException("open() the webcam first!", dev);}
-			if (io == nullptr) {io = getBestIO();}
+			if (io == nullptr) {io = createIO();}
+			if (numBuffers != 0) {io->setNumBuffers(numBuffers);}
+			io->setLatestOnly(latestOnly);
 			io->init(fmt.fmt.pix.sizeimage);
 			isInitialized = true;
 		}
@@ -104,6 +138,10 @@ namespace K {
 			if (isRunning) {return;}
 			io->start();
 			isRunning = true;
+
+			// the driver restarts its sequence numbers when streaming starts
+			hasSequence = false;
+			lastSkipped = io->getNumSkipped();
 		}
 
 		/** stop capturing */
@@ -135,9 +173,79 @@ namespace K {
 
 		}
 
+		/**
+		 * select the IO method to use for capturing (default: AUTO).
+		 * must be called before init(). switching from/to REPLAY must be done before open()
+		 */
+		void setIOMethod(const WebcamIOMethod method) {
+			if (isInitialized) {throw WebcamException("setIOMethod() must be called before init()", dev);}
+			if (isOpen && (method == WebcamIOMethod::REPLAY || ioMethod == WebcamIOMethod::REPLAY)) {throw WebcamException("REPLAY must be selected before open()", dev);}
+			if (io != nullptr) {delete io; io = nullptr;}
+			ioMethod = method;
+		}
+
+		/**
+		 * capture directly into the given caller-owned (page-aligned) buffers using USERPTR IO.
+		 * each buffer must hold one image (see getMaxImageSize() after setFormat()).
+		 * the buffers must outlive the webcam's initialization. must be called before init()
+		 */
+		void setUserBuffers(const std::vector<WebcamUserBuffer>& buffers) {
+			setIOMethod(WebcamIOMethod::USERPTR);
+			userBuffers = buffers;
+		}
+
+		/**
+		 * set the number of buffers the driver captures into (default: 4).
+		 * more buffers tolerate longer processing stalls, less buffers mean less latency.
+		 * must be called before init()
+		 */
+		void setNumBuffers(const uint32_t numBuffers) {
+			if (isInitialized) {throw WebcamException("setNumBuffers() must be called before init()", dev);}
+			if (numBuffers < 2) {throw WebcamException("at least 2 buffers are needed", dev);}
+			this->numBuffers = numBuffers;
+		}
+
+		/**
+		 * if enabled, readImage()/leaseImage() always return the most recent image
+		 * and skip all older ones waiting within the driver's queue.
+		 * keeps the latency at one frame-period even if processing falls behind.
+		 */
+		void setLatestFrameOnly(const bool latestOnly) {
+			this->latestOnly = latestOnly;
+			if (io != nullptr) {io->setLatestOnly(latestOnly);}
+		}
+
+		/**
+		 * (REPLAY only) the rate to serve the recorded frames at.
+		 * -1 = the recording's rate (default), 0 = as fast as possible
+		 */
+		void setReplayFPS(const double fps) {
+			replayFPS = fps;
+			if (isOpen && ioMethod == WebcamIOMethod::REPLAY && fps >= 0) {static_cast<WebcamIOReplay*>(io)->setFPS(fps);}
+		}
+
+		/** get the number of images skipped due to setLatestFrameOnly() */
+		uint64_t getNumSkippedFrames() const {return (io) ? (io->getNumSkipped()) : (0);}
+
+		/**
+		 * get the number of images the driver dropped (gaps within the sequence numbers),
+		 * e.g. because all buffers were in use. images skipped due to
+		 * setLatestFrameOnly() are not counted
+		 */
+		uint64_t getNumDroppedFrames() const {return numDropped;}
+
+		/** get the number of images the driver flagged as (possibly) corrupted */
+		uint64_t getNumErrorFrames() const {return numErrors;}
+
+		/** get the max. size (in bytes) one image of the configured format might have */
+		uint32_t getMaxImageSize() const {return fmt.fmt.pix.sizeimage;}
+
 		/** the the device-file-name */
 		const std::string& getDevice() const {return dev;}
 
+		/** get the device's file-descriptor (e.g. to wait for images using poll/epoll). -1 if not open or for REPLAY */
+		int getFD() const {return fd;}
+
 		/** read all supported pixel formats from the webcam */
 		const std::vector<PixelFormat>& getSupportedPixelFormats() {
 			return supportedPixelFormats;
@@ -148,6 +256,14 @@ namespace K {
 
 			debug(dev, "initializing: " << width << "x" << height << " @ " << pf);
 
+			// a recording only has the format it was recorded with
+			if (ioMethod == WebcamIOMethod::REPLAY) {
+				if (fmt.fmt.pix.width != width || fmt.fmt.pix.height != height || fmt.fmt.pix.pixelformat != pf._int) {
+					debug(dev, "format not available. recording uses: " << fmt.fmt.pix.width << "x" << fmt.fmt.pix.height << " @ " << PixelFormat(fmt.fmt.pix.pixelformat));
+				}
+				return;
+			}
+
 			// configure image format
 			CLEAR(fmt);
 			fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -175,14 +291,79 @@ namespace K {
 		 * @return the next image read from the webcam
 		 */
 		WebcamImage& readImage() {
+			return *readImage(-1);
+		}
+
+		/**
+		 * read the next image from the webcam, waiting at most the given time.
+		 * the calling thread sleeps on the device until an image is ready.
+		 * BEWARE! the returned data is volatile and belongs to the webcam!
+		 * @param timeoutMS the max. time to wait in milliseconds. -1 = forever, 0 = do not wait
+		 * @return the next image read from the webcam, or nullptr on timeout
+		 */
+		WebcamImage* readImage(const int timeoutMS) {
 
 			// read data from webcam and create WebcamImage
-			io->read(img.data);
+			if (!io->read(img.data, img.info, timeoutMS)) {return nullptr;}
+			track(img.info);
 			img.setParameters(fmt.fmt.pix.width, fmt.fmt.pix.height, PixelFormat(fmt.fmt.pix.pixelformat), img.data.usedBytes);
-			return img;
+			return &img;
 
 		}
 
+		/**
+		 * read the next image from the webcam into the given (caller-owned) image.
+		 * @param dst the image to read into
+		 * @param timeoutMS the max. time to wait in milliseconds. -1 = forever, 0 = do not wait
+		 * @return false on timeout
+		 */
+		bool readImage(WebcamImage& dst, const int timeoutMS) {
+
+			if (!io->read(dst.data, dst.info, timeoutMS)) {return false;}
+			track(dst.info);
+			dst.setParameters(fmt.fmt.pix.width, fmt.fmt.pix.height, PixelFormat(fmt.fmt.pix.pixelformat), dst.data.usedBytes);
+			return true;
+
+		}
+
+		/**
+		 * read the next image from the webcam, only if one is ready right now.
+		 * BEWARE! the returned data is volatile and belongs to the webcam!
+		 * @return the next image read from the webcam, or nullptr if none is ready
+		 */
+		WebcamImage* tryReadImage() {
+			return readImage(0);
+		}
+
+		/**
+		 * read the next image from the webcam without copying it.
+		 * the returned lease points directly into the driver's buffer which
+		 * is handed back to the driver once the lease is released/destroyed.
+		 * the more leases are held, the less buffers the driver has to capture into
+		 * (see isStarved()). if the IO does not support leasing, the image is copied.
+		 * for REPLAY, the leased image is read-only (see WebcamIOReplay).
+		 * @param timeoutMS the max. time to wait in milliseconds. -1 = forever, 0 = do not wait
+		 * @return a lease for the next image read from the webcam. invalid on timeout
+		 */
+		WebcamFrameLease leaseImage(const int timeoutMS = -1) {
+
+			WebcamFrameLease lease;
+			int32_t index;
+			if (!io->lease(lease.img.data, lease.img.info, index, timeoutMS)) {return lease;}
+			track(lease.img.info);
+			lease.index = index;
+			lease.io = io;
+			lease.img.setParameters(fmt.fmt.pix.width, fmt.fmt.pix.height, PixelFormat(fmt.fmt.pix.pixelformat), lease.img.data.usedBytes);
+			return lease;
+
+		}
+
+		/** get the number of images currently leased via leaseImage() */
+		uint32_t getNumLeased() const {return (io) ? (io->getNumLeased()) : (0);}
+
+		/** true if too many leases are held and the driver is (almost) out of buffers */
+		bool isStarved() const {return (io) ? (io->isStarved()) : (false);}
+
 		/** dump the webcam's capabilities */
 		void dumpCapabilities() {
 
@@ -203,6 +384,21 @@ namespace K {
 		/** the mode to use for IO (e.g. read/write, memory-mapped, ...) */
 		WebcamIO* io;
 
+		/** the IO method requested by the user */
+		WebcamIOMethod ioMethod;
+
+		/** caller-owned buffers to use for USERPTR IO (if any) */
+		std::vector<WebcamUserBuffer> userBuffers;
+
+		/** the number of driver-buffers to use (0 = IO's default) */
+		uint32_t numBuffers;
+
+		/** only read the most recent image? */
+		bool latestOnly;
+
+		/** the rate to replay recordings at (-1 = recorded rate) */
+		double replayFPS;
+
 		/** the file-descriptor for accessing the device */
 		int fd;
 
@@ -231,6 +427,46 @@ namespace K {
 		WebcamImage img;
 
 
+		/** was an image read since start()? (lastSequence is valid) */
+		bool hasSequence;
+
+		/** the sequence number of the last image read */
+		uint32_t lastSequence;
+
+		/** the IO's number of skipped images when the last image was read */
+		uint64_t lastSkipped;
+
+		/** the number of images dropped by the driver */
+		uint64_t numDropped;
+
+		/** the number of images flagged as corrupted */
+		uint64_t numErrors;
+
+
+		/** update the dropped/corrupted image statistics using the metadata of a newly read image */
+		void track(const WebcamFrameInfo& info) {
+
+			if (info.isError()) {++numErrors;}
+
+			// images skipped in latestOnly mode also leave a gap -> do not count them as dropped
+			const uint64_t skipped = io->getNumSkipped();
+			if (hasSequence) {
+				const uint32_t gap = info.sequence - lastSequence - 1;		// wraps around just like the sequence
+				const uint64_t numSkipped = skipped - lastSkipped;
+				if (gap > numSkipped && gap < 0x80000000u) {
+					numDropped += gap - numSkipped;
+					debugVerbose(dev, "driver dropped " << (gap - numSkipped) << " image(s) before #" << info.sequence);
+					traceEvent("capture.dropped", info.sequence, gap - numSkipped);
+				}
+			}
+
+			hasSequence = true;
+			lastSequence = info.sequence;
+			lastSkipped = skipped;
+
+		}
+
+
 		/** check if this device is a V4L2 device and supports capture */
 		void checkIsWebcam() {
 
@@ -293,6 +529,61 @@ namespace K {
 		}
 
 
+		/** create the IO for the requested method */
+		WebcamIO* createIO() {
+
+			switch (ioMethod) {
+
+				case WebcamIOMethod::AUTO:
+					return getBestIO();
+
+				case WebcamIOMethod::MMAP:
+					if (!(cap.capabilities & V4L2_CAP_STREAMING)) {throw WebcamException("device does not support streaming", dev);}
+					return new WebcamIOMMAP(fd, dev);
+
+				case WebcamIOMethod::USERPTR:
+					if (!(cap.capabilities & V4L2_CAP_STREAMING)) {throw WebcamException("device does not support streaming", dev);}
+					if (WebcamIOUserPtr::isSupported(fd)) {return new WebcamIOUserPtr(fd, dev, userBuffers);}
+					debug(dev, "USERPTR-IO not supported by the driver. falling back to MMAP-IO");
+					return new WebcamIOMMAP(fd, dev);
+
+				case WebcamIOMethod::RW:
+					if (!(cap.capabilities & V4L2_CAP_READWRITE)) {throw WebcamException("device does not support R/W", dev);}
+					return new WebcamIORW(fd, dev);
+
+				case WebcamIOMethod::REPLAY:
+					return new WebcamIOReplay(dev);
+
+			}
+
+			throw WebcamException("unknown IO method", dev);
+
+		}
+
+		/** open the recording (dev) and take the format and capabilities from it */
+		void openReplay() {
+
+			debug(dev, "opening recording");
+
+			WebcamIOReplay* replay = new WebcamIOReplay(dev);
+			if (io != nullptr) {delete io;}
+			io = replay;
+			if (replayFPS >= 0) {replay->setFPS(replayFPS);}
+			fd = -1;
+
+			const WebcamReplayHeader& header = replay->getHeader();
+			CLEAR(cap);
+			cap.capabilities = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+			CLEAR(fmt);
+			fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			fmt.fmt.pix.width       = header.width;
+			fmt.fmt.pix.height      = header.height;
+			fmt.fmt.pix.pixelformat = header.pixelFormat;
+			fmt.fmt.pix.sizeimage   = header.frameSize;
+			supportedPixelFormats.assign(1, PixelFormat(header.pixelFormat));
+
+		}
+
 		/** check all supported IO modes and select the best one */
 		WebcamIO* getBestIO() {
 
@@ -0,0 +1,188 @@
+#ifndef K_WEBCAMCAPTURETHREAD_H
+#define K_WEBCAMCAPTURETHREAD_H
+
+#include <atomic>
+#include <exception>
+#include <thread>
+
+#include "Webcam.h"
+#include "WebcamImageRing.h"
+
+namespace K {
+
+	/**
+	 * asynchronous capturing: a dedicated thread reads all images
+	 * from the webcam into a preallocated, lock-free ring.
+	 *
+	 * stalls within the consumer (conversion, encoding, ...) thus do
+	 * not stall the driver's queue. what happens if the consumer is too
+	 * slow for too long, is defined by the ring's overflow policy.
+	 *
+	 * usage:
+	 *	cam.open ... cam.start
+	 *	WebcamCaptureThread capture(cam, 8, RingOverflow::DROP_OLDEST);
+	 *	capture.start();
+	 *	while (...) {
+	 *		WebcamImage* img = capture.acquire(100);
+	 *		if (img) {process(*img); capture.release();}
+	 *	}
+	 *	capture.stop();
+	 *
+	 */
+	class WebcamCaptureThread {
+
+	public:
+
+		/**
+		 * ctor
+		 * @param cam the (already started) webcam to read images from
+		 * @param numSlots the number of images to buffer
+		 * @param overflow what to do when the consumer does not keep up
+		 */
+		WebcamCaptureThread(Webcam& cam, const uint32_t numSlots, const RingOverflow overflow) :
+			cam(cam), ring(numSlots, cam.getMaxImageSize(), overflow), running(false) {
+			;
+		}
+
+		/** dtor */
+		virtual ~WebcamCaptureThread() {
+			running = false;
+			ring.close();
+			if (thread.joinable()) {thread.join();}
+		}
+
+		/** start the capture thread */
+		void start() {
+			if (running) {return;}
+			if (thread.joinable()) {thread.join();}
+			ring.reopen();
+			running = true;
+			thread = std::thread(&WebcamCaptureThread::run, this);
+		}
+
+		/** stop the capture thread (waking up a waiting acquire()). rethrows any error that occurred while capturing */
+		void stop() {
+			running = false;
+			ring.close();
+			if (thread.joinable()) {thread.join();}
+			rethrow();
+		}
+
+		/**
+		 * get the oldest captured image (lock-free).
+		 * the image belongs to the caller until release() is called.
+		 * only one image can be acquired at a time.
+		 * @param timeoutMS the max. time to wait. -1 = forever, 0 = do not wait
+		 * @return the image or nullptr on timeout (or after stop())
+		 * @throws the error that stopped the capture thread (also while waiting)
+		 */
+		WebcamImage* acquire(const int timeoutMS = 0) {
+			rethrow();
+			WebcamImage* img = ring.acquire(timeoutMS);
+			if (img == nullptr) {rethrow();}
+			return img;
+		}
+
+		/** hand the image returned by acquire() back to the capture thread */
+		void release() {
+			ring.release();
+		}
+
+		/** get the number of images that were dropped because the consumer did not keep up */
+		uint64_t getNumDropped() const {return ring.getNumDropped();}
+
+	protected:
+
+		/**
+		 * read the next image into dst (called by the capture thread).
+		 * overriding allows e.g. tests to inject errors. derived classes must stop() the thread within their dtor
+		 * @return false on timeout
+		 */
+		virtual bool capture(WebcamImage& dst, const int timeoutMS) {
+			return cam.readImage(dst, timeoutMS);
+		}
+
+	private:
+
+		/** the max. time the thread waits for something before checking whether to stop */
+		static constexpr int WAIT_MS = 100;
+
+		/** the webcam to read from */
+		Webcam& cam;
+
+		/** the images read by the thread */
+		WebcamImageRing ring;
+
+		/** the capture thread */
+		std::thread thread;
+
+		/** keep the thread running? */
+		std::atomic<bool> running;
+
+		/** error that stopped the capture thread (if any) */
+		std::exception_ptr error;
+
+		/** receives images that have to be dropped */
+		WebcamImage scratch;
+
+		/** the capture thread's main-loop */
+		void run() {
+
+			try {
+
+				while (running) {
+
+					// get the slot to capture into
+					WebcamImage* slot = ring.beginWrite(WAIT_MS);
+
+					// no slot available -> fetch and discard the image to keep the driver's queue moving
+					if (slot == nullptr) {
+						if (ring.getOverflow() != RingOverflow::BLOCK) {capture(scratch, WAIT_MS);}
+						continue;
+					}
+
+					// capture directly into the slot. on errors, the slot must be given back, or it stays claimed forever
+					bool ok;
+					try {
+						ok = capture(*slot, WAIT_MS);
+					} catch (...) {
+						ring.abortWrite();
+						throw;
+					}
+
+					if (ok)	{ring.commitWrite();}
+					else	{ring.abortWrite();}
+
+				}
+
+			} catch (...) {
+
+				error = std::current_exception();
+				running = false;
+
+				// wake up a consumer waiting for the next image
+				ring.close();
+
+			}
+
+		}
+
+		/** rethrow the capture thread's error (if any) */
+		void rethrow() {
+			if (running || !error) {return;}
+			std::exception_ptr e = error;
+			error = nullptr;
+			std::rethrow_exception(e);
+		}
+
+		/** hidden copy ctor */
+		WebcamCaptureThread(const WebcamCaptureThread&);
+
+		/** hidden assignment operator */
+		WebcamCaptureThread& operator = (const WebcamCaptureThread&);
+
+	};
+
+}
+
+#endif // K_WEBCAMCAPTURETHREAD_H
@@ -0,0 +1,98 @@
+#ifndef K_WEBCAMFRAMELEASE_H
+#define K_WEBCAMFRAMELEASE_H
+
+#include "../image/WebcamImage.h"
+#include "WebcamIO.h"
+
+namespace K {
+
+	/**
+	 * RAII handle for an image that points directly into one of the
+	 * driver's (e.g. mmap'd) buffers, without copying it.
+	 *
+	 * as long as the lease exists, the driver can not capture into this buffer.
+	 * once the lease is released (or destroyed) the buffer is handed back
+	 * to the driver and the image's data must not be used any more!
+	 *
+	 * release all leases before stopping the Webcam they belong to.
+	 *
+	 * usage:
+	 *	WebcamFrameLease lease = cam.leaseImage();
+	 *	process(lease.getImage());
+	 *	// buffer is re-queued when "lease" goes out of scope
+	 *
+	 */
+	class WebcamFrameLease {
+
+	public:
+
+		/** empty (invalid) lease */
+		WebcamFrameLease() : io(nullptr), index(WebcamIO::NO_LEASE) {
+			;
+		}
+
+		/** dtor. hands the buffer back to the driver */
+		~WebcamFrameLease() {
+			release();
+		}
+
+		/** move ctor */
+		WebcamFrameLease(WebcamFrameLease&& o) : io(o.io), index(o.index), img(std::move(o.img)) {
+			o.io = nullptr;
+			o.index = WebcamIO::NO_LEASE;
+		}
+
+		/** move assignment. releases the currently held buffer (if any) */
+		WebcamFrameLease& operator = (WebcamFrameLease&& o) {
+			if (this == &o) {return *this;}
+			release();
+			io = o.io;
+			index = o.index;
+			img = std::move(o.img);
+			o.io = nullptr;
+			o.index = WebcamIO::NO_LEASE;
+			return *this;
+		}
+
+		/** get the leased image. only valid until the lease is released! */
+		const WebcamImage& getImage() const {return img;}
+
+		/** does this lease point into one of the driver's buffers? (false if the image was copied) */
+		bool isZeroCopy() const {return index != WebcamIO::NO_LEASE;}
+
+		/** does this lease (still) hold an image? */
+		bool isValid() const {return io != nullptr;}
+
+		/** hand the buffer back to the driver. the image must not be used afterwards */
+		void release() {
+			if (io == nullptr) {return;}
+			io->release(index);
+			io = nullptr;
+			index = WebcamIO::NO_LEASE;
+			img.reset();
+		}
+
+	private:
+
+		friend class Webcam;
+
+		/** hidden copy ctor. not allowed */
+		WebcamFrameLease(const WebcamFrameLease&);
+
+		/** hidden assignment operator. not allowed */
+		WebcamFrameLease& operator = (const WebcamFrameLease&);
+
+		/** the IO the buffer belongs to */
+		WebcamIO* io;
+
+		/** the index of the leased buffer within the IO */
+		int32_t index;
+
+		/** the image pointing to the leased buffer */
+		WebcamImage img;
+
+	};
+
+}
+
+#endif // K_WEBCAMFRAMELEASE_H
@@ -2,11 +2,16 @@
 #define K_WEBCAMIO_H
 
 #include <sys/ioctl.h>			// IO-commands
+#include <poll.h>				// blocking waits
+#include <time.h>
 #include <errno.h>				// error handling
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 #include "../image/DataBuffer.h"
+#include "../image/WebcamFrameInfo.h"
+#include "WebcamException.h"
 
 /** reset provided element's memory to zeros */
 #define CLEAR(x) memset(&(x), 0, sizeof(x))
@@ -38,8 +43,67 @@ namespace K {
 		/** perform necessary setup to start capuring */
 		virtual void start() = 0;
 
-		/** read one image into the provided buffer */
-		virtual void read(DataBuffer& dst) = 0;
+		/**
+		 * read one image into the provided buffer
+		 * @param dst the buffer to read the image into
+		 * @param info receives the image's capture metadata (timestamp, sequence, flags)
+		 * @param timeoutMS the max. time to wait for an image. -1 = forever, 0 = do not wait
+		 * @return false if no image was available within the timeout
+		 */
+		virtual bool read(DataBuffer& dst, WebcamFrameInfo& info, const int timeoutMS) = 0;
+
+		/** read one image into the provided buffer (wait until available) */
+		void read(DataBuffer& dst) {WebcamFrameInfo info; read(dst, info, -1);}
+
+		/**
+		 * dequeue the next image and let the provided buffer point directly
+		 * to the driver's memory, without copying.
+		 * the memory belongs to the driver again once release() is called
+		 * with the returned index.
+		 * IO methods that can not hand out their buffers copy the image
+		 * instead and return NO_LEASE as index.
+		 * @param dst the buffer to point to the image
+		 * @param info receives the image's capture metadata (timestamp, sequence, flags)
+		 * @param index the index of the leased buffer or NO_LEASE
+		 * @param timeoutMS the max. time to wait for an image. -1 = forever, 0 = do not wait
+		 * @return false if no image was available within the timeout
+		 */
+		virtual bool lease(DataBuffer& dst, WebcamFrameInfo& info, int32_t& index, const int timeoutMS) {
+			index = NO_LEASE;
+			return read(dst, info, timeoutMS);
+		}
+
+		/** hand the buffer with the given (leased) index back to the driver */
+		virtual void release(const int32_t index) {(void) index;}
+
+		/**
+		 * set the number of buffers the driver should capture into (if the IO uses any).
+		 * more buffers tolerate longer processing stalls, less buffers mean less latency.
+		 * must be called before init()
+		 */
+		virtual void setNumBuffers(const uint32_t numBuffers) {(void) numBuffers;}
+
+		/**
+		 * if enabled, reading returns the most recent image only. all older images
+		 * already waiting within the driver's queue are skipped (and re-queued).
+		 * keeps the latency at one frame-period even if processing falls behind
+		 */
+		virtual void setLatestOnly(const bool latestOnly) {(void) latestOnly;}
+
+		/** get the number of images skipped due to setLatestOnly() */
+		virtual uint64_t getNumSkipped() const {return 0;}
+
+		/** get the number of buffers currently leased by the user */
+		virtual uint32_t getNumLeased() const {return 0;}
+
+		/**
+		 * true if the user holds so many leases, that the driver
+		 * is (almost) out of buffers to capture into
+		 */
+		virtual bool isStarved() const {return false;}
+
+		/** index returned by lease() if the image was copied instead */
+		static constexpr int32_t NO_LEASE = -1;
 
 		/** perform necessary shutdown after capturing */
 		virtual void stop() = 0;
@@ -62,6 +126,49 @@ namespace K {
 
 		}
 
+		/**
+		 * block (without burning CPU) until the device has data to read
+		 * @param fh the device's file-descriptor
+		 * @param timeoutMS the max. time to wait. -1 = forever, 0 = do not wait
+		 * @param dev the device name (for error messages)
+		 * @return false if the timeout expired without data becoming available
+		 */
+		static bool waitReadable(const int fh, const int timeoutMS, const std::string& dev) {
+
+			struct pollfd pfd;
+			pfd.fd = fh;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+
+			const int r = ::poll(&pfd, 1, timeoutMS);
+			if (r > 0)			{return true;}
+			if (r == 0)			{return false;}
+			if (errno == EINTR)	{return true;}		// interrupted -> let the caller retry
+			throw WebcamException("error while waiting for image", dev, errno);
+
+		}
+
+		/** get the current (monotonic) time in milliseconds. used for timeouts */
+		static uint64_t nowMS() {
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+		}
+
+		/** get the current (monotonic) time in nanoseconds. same clock as the drivers' timestamps */
+		static uint64_t nowNS() {
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+		}
+
+		/** get the time left until the given deadline (see nowMS()), for the given timeout (-1 = forever) */
+		static int remainingMS(const int timeoutMS, const uint64_t deadline) {
+			if (timeoutMS <= 0) {return timeoutMS;}
+			const uint64_t now = nowMS();
+			return (now >= deadline) ? (0) : (int) (deadline - now);
+		}
+
 	};
 
 }
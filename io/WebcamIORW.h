@@ -20,10 +20,13 @@ namespace K {
 
 		uint32_t maxImageSize;
 
+		/** the number of images read so far (there is no driver sequence for R/W) */
+		uint32_t sequence;
+
 	public:
 
 		/** ctor */
-		WebcamIORW(int fd, const std::string& dev) : fd(fd), dev(dev) {
+		WebcamIORW(int fd, const std::string& dev) : maxImageSize(0), sequence(0), fd(fd), dev(dev) {
 			;
 		}
 
@@ -44,23 +47,36 @@ namespace K {
 
 			// nothing to do here
 			debug(dev, "\tstarting R/W-IO");
+			sequence = 0;
 
 		}
 
-		void read(DataBuffer& dst) override {
+		bool read(DataBuffer& dst, WebcamFrameInfo& info, const int timeoutMS) override {
 
-			debug(dev, "reading image (using R/W-IO)");
+			debugVerbose(dev, "reading image (using R/W-IO)");
 			dst.ensureSpace(maxImageSize);
-			int numBytes = 0;
+			ssize_t numBytes = 0;
 
 			// try to read one image
+			const uint64_t deadline = WebcamIO::nowMS() + ((timeoutMS > 0) ? (timeoutMS) : (0));
 			while(true) {
 				numBytes = ::read(fd, dst.getData(), maxImageSize);
-				if		(numBytes > 0)		{break;}										// image available -> proceed
-				else if	(errno == EAGAIN)	{usleep(10); continue;}							// wait some time and try again
-				else						{throw WebcamException("error while reading image", dev, errno);}	// error
+				if		(numBytes > 0)							{break;}										// image available -> proceed
+				else if	(numBytes < 0 && errno == EINTR)		{continue;}										// interrupted -> try again
+				else if	(numBytes == 0 || errno != EAGAIN)		{throw WebcamException("error while reading image", dev, errno);}	// error
+				if (timeoutMS == 0)								{return false;}									// do not wait
+				if (!WebcamIO::waitReadable(fd, WebcamIO::remainingMS(timeoutMS, deadline), dev)) {return false;}	// sleep until ready or timeout
 			}
 
+			dst.setBytesUsed((uint32_t) numBytes);
+
+			// the driver does not tell when the image was captured -> use the time of reading
+			info.timestampNS = WebcamIO::nowNS();
+			info.sequence = sequence++;
+			info.flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+			traceEvent("capture", info.sequence, info.timestampNS);
+			return true;
+
 		}
 
 		void stop() override {
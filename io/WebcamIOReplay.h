@@ -0,0 +1,364 @@
+#ifndef K_WEBCAMIO_REPLAY_H
+#define K_WEBCAMIO_REPLAY_H
+
+#include "WebcamIO.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../image/WebcamImage.h"
+#include "../Debug.h"
+#include "WebcamException.h"
+
+namespace K {
+
+	/**
+	 * the header of a raw recording, followed by fixed-size frames
+	 * (native byte order)
+	 */
+	struct WebcamReplayHeader {
+
+		/** "KRAW" */
+		char magic[4];
+
+		/** the file-format's version (1) */
+		uint32_t version;
+
+		/** the frames' size and format */
+		uint32_t width;
+		uint32_t height;
+		uint32_t pixelFormat;
+
+		/** the size of each frame in bytes */
+		uint32_t frameSize;
+
+		/** the frame rate used for recording (0 = unknown) */
+		uint32_t fps;
+
+		uint32_t reserved;
+
+	};
+
+	/**
+	 * webcam-IO serving the frames of a recorded raw file instead of a device.
+	 * allows testing and benchmarking everything behind Webcam::readImage()
+	 * without a camera (see WebcamIOMethod::REPLAY).
+	 *
+	 * the file is memory-mapped (read-only). read() copies one frame, lease() points
+	 * directly into the mapping. the recording is played in an endless loop,
+	 * thus leased images are READ-ONLY: every later loop serves the same memory
+	 * (writing to it crashes instead of silently corrupting the recording).
+	 *
+	 * frames are either paced at a given frame rate, like a camera, or
+	 * served as fast as possible (fps = 0).
+	 * when paced, the IO behaves like a driver with setNumBuffers() buffers:
+	 * if the reader falls behind by more frames, the oldest ones are dropped
+	 * (gap within the sequence numbers) or skipped in setLatestOnly() mode.
+	 */
+	class WebcamIOReplay : public WebcamIO {
+
+	public:
+
+		/** current file-format version */
+		static constexpr uint32_t VERSION = 1;
+
+		/**
+		 * ctor. opens and maps the recording
+		 * @param file the recording to play
+		 */
+		WebcamIOReplay(const std::string& file) :
+			file(file), fd(-1), map(nullptr), mapSize(0), numFrames(0), periodNS(0),
+			numBuffers(4), latestOnly(false), numSkipped(0), startNS(0), next(0) {
+
+			try {
+				open();
+			} catch (...) {
+				close();
+				throw;
+			}
+
+			// replay at the recorded frame rate by default
+			setFPS(header.fps);
+
+			debug(file, "\treplaying " << numFrames << " frames " << header.width << "x" << header.height << " @ " << PixelFormat(header.pixelFormat));
+
+		}
+
+		/** dtor */
+		~WebcamIOReplay() {
+			close();
+		}
+
+		/** get the recording's header (size, format, frame rate) */
+		const WebcamReplayHeader& getHeader() const {return header;}
+
+		/** get the number of frames within the recording */
+		uint32_t getNumFrames() const {return numFrames;}
+
+		/** serve frames at the given rate. 0 = as fast as possible */
+		void setFPS(const double fps) {
+			periodNS = (fps > 0) ? ((uint64_t) (1000000000.0 / fps)) : (0);
+		}
+
+		void init(const uint32_t maxImageSize) override {
+			debug(file, "\tinitializing REPLAY-IO");
+			if (maxImageSize < header.frameSize) {throw WebcamException("recorded frames exceed the max. image size", file);}
+		}
+
+		void start() override {
+			debug(file, "\tstarting REPLAY-IO");
+			startNS = WebcamIO::nowNS();
+			next = 0;
+		}
+
+		bool read(DataBuffer& dst, WebcamFrameInfo& info, const int timeoutMS) override {
+
+			debugVerbose(file, "reading image (using REPLAY-IO)");
+
+			const uint8_t* frame = nextFrame(info, timeoutMS);
+			if (!frame) {return false;}
+
+			dst.ensureSpace(header.frameSize);
+			memcpy(dst.getData(), frame, header.frameSize);
+			dst.setBytesUsed(header.frameSize);
+			return true;
+
+		}
+
+		bool lease(DataBuffer& dst, WebcamFrameInfo& info, int32_t& index, const int timeoutMS) override {
+
+			debugVerbose(file, "leasing image (using REPLAY-IO)");
+
+			uint8_t* frame = nextFrame(info, timeoutMS);
+			if (!frame) {return false;}
+
+			// the mapping stays valid as long as the IO exists -> nothing to hand back.
+			// read-only: the frame is served again by every loop
+			dst.wrap(frame, header.frameSize);
+			index = (int32_t) ((next - 1) % numFrames);
+			return true;
+
+		}
+
+		void setNumBuffers(const uint32_t numBuffers) override {this->numBuffers = numBuffers;}
+
+		void setLatestOnly(const bool latestOnly) override {this->latestOnly = latestOnly;}
+
+		uint64_t getNumSkipped() const override {return numSkipped;}
+
+		void stop() override {
+			debug(file, "\tstopping REPLAY-IO");
+		}
+
+		void uninit() override {
+			debug(file, "\tun-initializing REPLAY-IO");
+		}
+
+	private:
+
+		/** the recording's file name */
+		std::string file;
+
+		/** the recording's file-descriptor */
+		int fd;
+
+		/** the mapped recording */
+		uint8_t* map;
+		size_t mapSize;
+
+		/** the recording's header */
+		WebcamReplayHeader header;
+
+		/** the number of frames within the recording */
+		uint32_t numFrames;
+
+		/** the time between two frames. 0 = as fast as possible */
+		uint64_t periodNS;
+
+		/** the number of frames a reader might fall behind, before frames are dropped */
+		uint32_t numBuffers;
+
+		/** only serve the most recent frame? */
+		bool latestOnly;
+
+		/** the number of frames skipped in latestOnly mode */
+		uint64_t numSkipped;
+
+		/** when start() was called */
+		uint64_t startNS;
+
+		/** the sequence number of the next frame to serve */
+		uint64_t next;
+
+
+		/** open and map the recording, read its header */
+		void open() {
+
+			fd = ::open(file.c_str(), O_RDONLY);
+			if (fd == -1) {throw WebcamException("error while opening recording", file, errno);}
+
+			struct stat st;
+			if (fstat(fd, &st) != 0) {throw WebcamException("error while reading recording's size", file, errno);}
+			mapSize = (size_t) st.st_size;
+			if (mapSize < sizeof(WebcamReplayHeader)) {throw WebcamException("recording is too small", file);}
+
+			// read-only: every loop must serve the recorded frames unchanged (see lease())
+			map = (uint8_t*) mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (map == MAP_FAILED) {map = nullptr; throw WebcamException("error while mapping recording", file, errno);}
+
+			memcpy(&header, map, sizeof(header));
+			if (memcmp(header.magic, "KRAW", 4) != 0)	{throw WebcamException("not a raw recording", file);}
+			if (header.version != VERSION)				{throw WebcamException("unsupported recording version", file);}
+			if (header.frameSize == 0)					{throw WebcamException("invalid frame size", file);}
+
+			numFrames = (uint32_t) ((mapSize - sizeof(header)) / header.frameSize);
+			if (numFrames == 0) {throw WebcamException("recording contains no frames", file);}
+
+		}
+
+		/** unmap and close the recording */
+		void close() {
+			if (map) {munmap(map, mapSize); map = nullptr;}
+			if (fd != -1) {::close(fd); fd = -1;}
+		}
+
+		/**
+		 * wait until the next frame is due and return it
+		 * @return the frame's data, or nullptr on timeout
+		 */
+		uint8_t* nextFrame(WebcamFrameInfo& info, const int timeoutMS) {
+
+			if (periodNS == 0) {
+
+				info.timestampNS = WebcamIO::nowNS();
+
+			} else {
+
+				// wait until the next frame is due (or the timeout expired)
+				const uint64_t dueNS = startNS + next * periodNS;
+				uint64_t now = WebcamIO::nowNS();
+				if (now < dueNS) {
+					if (timeoutMS == 0) {return nullptr;}
+					const uint64_t wakeNS = (timeoutMS < 0) ? (dueNS) : (std::min<uint64_t>(dueNS, now + (uint64_t) timeoutMS * 1000000ull));
+					sleepUntil(wakeNS);
+					now = WebcamIO::nowNS();
+					if (now < dueNS) {return nullptr;}
+				}
+
+				// the most recent frame that is due
+				const uint64_t latest = (now - startNS) / periodNS;
+				if (latestOnly) {
+					numSkipped += latest - next;
+					next = latest;
+				} else if (latest - next >= numBuffers) {
+					next = latest - numBuffers + 1;			// all buffers were full -> the "driver" dropped frames
+				}
+
+				info.timestampNS = startNS + next * periodNS;
+
+			}
+
+			info.sequence = (uint32_t) next;
+			info.flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+			traceEvent("capture", info.sequence, info.timestampNS);
+
+			const uint32_t idx = (uint32_t) (next % numFrames);
+			++next;
+			return map + sizeof(WebcamReplayHeader) + (size_t) idx * header.frameSize;
+
+		}
+
+		/** sleep until the given (monotonic) time */
+		static void sleepUntil(const uint64_t timeNS) {
+			struct timespec ts;
+			ts.tv_sec = (time_t) (timeNS / 1000000000ull);
+			ts.tv_nsec = (long) (timeNS % 1000000000ull);
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {;}
+		}
+
+		/** hidden copy ctor */
+		WebcamIOReplay(const WebcamIOReplay&);
+
+		/** hidden assignment operator */
+		WebcamIOReplay& operator = (const WebcamIOReplay&);
+
+	};
+
+	/**
+	 * write a raw recording that can be played by WebcamIOReplay.
+	 *
+	 * usage:
+	 *	WebcamReplayWriter rec("cam.raw", 30);
+	 *	while (...) {rec.write(cam.readImage());}
+	 */
+	class WebcamReplayWriter {
+
+	public:
+
+		/**
+		 * ctor. creates (or truncates) the file.
+		 * the first written image determines the size and format of all frames
+		 * @param fps the recording's frame rate (0 = unknown)
+		 */
+		WebcamReplayWriter(const std::string& file, const uint32_t fps) : file(file), fps(fps), numFrames(0) {
+			fp = fopen(file.c_str(), "wb");
+			if (!fp) {throw WebcamException("error while creating recording", file, errno);}
+		}
+
+		/** dtor */
+		~WebcamReplayWriter() {
+			if (fp) {fclose(fp);}
+		}
+
+		/** append one image. all images must have the same size and format */
+		void write(const WebcamImage& img) {
+
+			if (numFrames == 0) {
+				memcpy(header.magic, "KRAW", 4);
+				header.version = WebcamIOReplay::VERSION;
+				header.width = img.getWidth();
+				header.height = img.getHeight();
+				header.pixelFormat = img.getPixelFormat()._int;
+				header.frameSize = img.getNumBytes();
+				header.fps = fps;
+				header.reserved = 0;
+				if (fwrite(&header, sizeof(header), 1, fp) != 1) {throw WebcamException("error while writing recording", file, errno);}
+			}
+
+			if (img.getWidth() != header.width || img.getHeight() != header.height ||
+				img.getPixelFormat()._int != header.pixelFormat || img.getNumBytes() != header.frameSize) {
+				throw WebcamException("all frames of a recording must have the same size and format", file);
+			}
+
+			if (fwrite(img.getData(), header.frameSize, 1, fp) != 1) {throw WebcamException("error while writing recording", file, errno);}
+			++numFrames;
+
+		}
+
+		/** get the number of frames written so far */
+		uint32_t getNumFrames() const {return numFrames;}
+
+	private:
+
+		std::string file;
+		uint32_t fps;
+		FILE* fp;
+		WebcamReplayHeader header;
+		uint32_t numFrames;
+
+		/** hidden copy ctor */
+		WebcamReplayWriter(const WebcamReplayWriter&);
+
+		/** hidden assignment operator */
+		WebcamReplayWriter& operator = (const WebcamReplayWriter&);
+
+	};
+
+}
+
+#endif // K_WEBCAMIO_REPLAY_H
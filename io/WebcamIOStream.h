@@ -0,0 +1,278 @@
+#ifndef K_WEBCAMIO_STREAM_H
+#define K_WEBCAMIO_STREAM_H
+
+#include "WebcamIO.h"
+#include <string>
+#include <vector>
+#include <linux/videodev2.h>
+
+#include "../Debug.h"
+#include "WebcamException.h"
+
+namespace K {
+
+	/** one buffer the driver captures into */
+	struct WebcamIOStreamBuffer {
+		void* start;
+		size_t length;
+		bool leased;
+		WebcamIOStreamBuffer() : start(nullptr), length(0), leased(false) {;}
+	};
+
+	/**
+	 * base-class for all streaming IO methods (Memory-Mapped, User-Pointers).
+	 *
+	 * handles the driver's buffer-queue: enqueueing, dequeueing (blocking using poll)
+	 * and leasing buffers to the user. the derived classes only provide the
+	 * buffers themselves.
+	 */
+	class WebcamIOStream : public WebcamIO {
+
+	public:
+
+		/** ctor */
+		WebcamIOStream(const int fd, const std::string& dev, const enum v4l2_memory memory) :
+			maxImageSize(0), fd(fd), dev(dev), memory(memory), numBuffersWanted(4), numLeased(0), latestOnly(false), numSkipped(0) {
+			;
+		}
+
+		void start() override {
+
+			// START CAPTURING
+			debug(dev, "\tstarting " << getName() << " (-> start streaming)");
+
+			// hand all buffers to the driver
+			for (uint32_t i = 0; i < buffers.size(); ++i) {enqueue(i);}
+
+			// start the stream
+			enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			if (WebcamIO::xioctl(fd, VIDIOC_STREAMON, &type) != 0) {throw WebcamException("error while starting stream", dev);}
+
+		}
+
+		bool read(DataBuffer& dst, WebcamFrameInfo& info, const int timeoutMS) override {
+
+			debugVerbose(dev, "reading image (using " << getName() << ")");
+
+			struct v4l2_buffer buf;
+			if (!dequeue(buf, timeoutMS)) {return false;}
+
+			// we copy this buffer to a temporal one, as the driver might
+			// already be overwriting it while the user still reads from it..
+			// this results in very funny image glitches ;)
+			dst.ensureSpace(maxImageSize);
+			memcpy(dst.getData(), buffers[buf.index].start, buf.bytesused);
+			dst.setBytesUsed(buf.bytesused);
+			info = WebcamFrameInfo(buf);
+			traceEvent("capture", info.sequence, info.timestampNS);
+
+			// re-enque the buffer (make it usable again)
+			enqueue(buf.index);
+			return true;
+
+		}
+
+		bool lease(DataBuffer& dst, WebcamFrameInfo& info, int32_t& index, const int timeoutMS) override {
+
+			debugVerbose(dev, "leasing image (using " << getName() << ")");
+
+			struct v4l2_buffer buf;
+			if (!dequeue(buf, timeoutMS)) {return false;}
+
+			// the buffer stays dequeued (the driver will not touch it) until it is released
+			buffers[buf.index].leased = true;
+			++numLeased;
+			dst.wrap((uint8_t*) buffers[buf.index].start, buf.bytesused);
+			info = WebcamFrameInfo(buf);
+			traceEvent("capture", info.sequence, info.timestampNS);
+
+			// the log is written once, when becoming starved (each lease costs one buffer). tracing shows every starved lease
+			if (isStarved()) {
+				const uint32_t numLeft = (uint32_t) (buffers.size() - numLeased);
+				traceEvent("capture.starved", info.sequence, numLeft);
+				if (numLeft == 1) {debug(dev, "only " << numLeft << " of " << buffers.size() << " buffers left for the driver. release some leases!");}
+			}
+
+			index = (int32_t) buf.index;
+			return true;
+
+		}
+
+		void release(const int32_t index) override {
+
+			// ignore buffers that are not (or no longer) leased, e.g. after stop()
+			if (index < 0 || (uint32_t) index >= buffers.size()) {return;}
+			if (!buffers[index].leased) {return;}
+
+			buffers[index].leased = false;
+			--numLeased;
+
+			// re-enque the buffer (make it usable again)
+			enqueue(index);
+
+		}
+
+		void setNumBuffers(const uint32_t numBuffers) override {
+			if (numBuffers < 2) {throw WebcamException("at least 2 buffers are needed for streaming", dev);}
+			numBuffersWanted = numBuffers;
+		}
+
+		void setLatestOnly(const bool latestOnly) override {this->latestOnly = latestOnly;}
+
+		uint64_t getNumSkipped() const override {return numSkipped;}
+
+		uint32_t getNumLeased() const override {return numLeased;}
+
+		bool isStarved() const override {return buffers.size() - numLeased < 2;}
+
+		void stop() override {
+
+			debug(dev, "\tstopping " << getName() << " (-> stop streaming)");
+
+			// stop the stream
+			enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			WebcamIO::xioctl(fd, VIDIOC_STREAMOFF, &type);
+
+			// stopping removes all buffers from the driver's queues -> forget all leases
+			for (WebcamIOStreamBuffer& b : buffers) {b.leased = false;}
+			numLeased = 0;
+
+		}
+
+	protected:
+
+		/** the max. size of one image */
+		uint32_t maxImageSize;
+
+		/** the file-descriptor for accessing the device */
+		const int fd;
+
+		/** the device name */
+		std::string dev;
+
+		/** the type of memory used for the buffers (MMAP, USERPTR) */
+		const enum v4l2_memory memory;
+
+		/** the number of buffers to request from the driver */
+		uint32_t numBuffersWanted;
+
+		/** the buffers to use for reading */
+		std::vector<WebcamIOStreamBuffer> buffers;
+
+		/** the number of buffers currently leased by the user (not available to the driver) */
+		uint32_t numLeased;
+
+		/** only return the most recent image? */
+		bool latestOnly;
+
+		/** the number of images skipped in latestOnly mode */
+		uint64_t numSkipped;
+
+
+		/** the IO's name, for debug output */
+		virtual const char* getName() const = 0;
+
+		/**
+		 * request the given number of buffers from the driver.
+		 * @return the number of buffers the driver actually granted
+		 */
+		uint32_t requestBuffers(const uint32_t count) {
+
+			struct v4l2_requestbuffers req;
+			CLEAR(req);
+			req.count = count;
+			req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			req.memory = memory;
+			int ret = WebcamIO::xioctl(fd, VIDIOC_REQBUFS, &req);
+
+			// check if everything went fine
+			if (ret == EINVAL)	{throw WebcamException(std::string("does not support ") + getName(), dev);}
+			if (ret != 0)		{throw WebcamException("error while requesting buffers", dev, ret);}
+			if (req.count < 2)	{throw WebcamException("insufficient buffer memory", dev);}
+
+			return req.count;
+
+		}
+
+		/** let the driver free all of its buffers (best effort, used during shutdown) */
+		void freeBuffers() {
+			struct v4l2_requestbuffers req;
+			CLEAR(req);
+			req.count = 0;
+			req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			req.memory = memory;
+			WebcamIO::xioctl(fd, VIDIOC_REQBUFS, &req);
+		}
+
+		/** hand the buffer with the given index (back) to the driver */
+		void enqueue(const uint32_t index) {
+
+			struct v4l2_buffer buf;
+			CLEAR(buf);
+			buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			buf.memory = memory;
+			buf.index = index;
+
+			// user-pointer IO must tell the driver where to write to
+			if (memory == V4L2_MEMORY_USERPTR) {
+				buf.m.userptr = (unsigned long) buffers[index].start;
+				buf.length = buffers[index].length;
+			}
+
+			if (WebcamIO::xioctl(fd, VIDIOC_QBUF, &buf) != 0) {throw WebcamException("error while queueing buffer", dev, errno);}
+
+		}
+
+		/**
+		 * dequeue the next filled buffer from the driver.
+		 * blocks on the device until a buffer is ready or the timeout expired
+		 * @return false on timeout
+		 */
+		bool dequeue(struct v4l2_buffer& buf, const int timeoutMS) {
+
+			// if all buffers are leased, the driver has nothing to capture into
+			if (numLeased >= buffers.size()) {throw WebcamException("all buffers are leased. the driver is starved", dev);}
+
+			CLEAR(buf);
+			buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			buf.memory = memory;
+
+			// read until available
+			const uint64_t deadline = WebcamIO::nowMS() + ((timeoutMS > 0) ? (timeoutMS) : (0));
+			while(true) {
+				int ret = WebcamIO::xioctl(fd, VIDIOC_DQBUF, &buf);
+				if		(ret == 0)		{break;}																// image available -> proceed
+				else if	(ret != EAGAIN)	{throw WebcamException("error while reading image", dev, ret);}		// error
+				if (timeoutMS == 0)		{return false;}														// do not wait
+				if (!WebcamIO::waitReadable(fd, WebcamIO::remainingMS(timeoutMS, deadline), dev)) {return false;}	// sleep until ready or timeout
+			}
+
+			// sanity check
+			if (buf.index >= buffers.size()) {throw WebcamException("buffer index out of range", dev);}
+
+			// skip all older images: fetch newer ones (without waiting) and re-queue the older ones
+			if (latestOnly) {
+				struct v4l2_buffer newer;
+				while (true) {
+					CLEAR(newer);
+					newer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+					newer.memory = memory;
+					const int ret = WebcamIO::xioctl(fd, VIDIOC_DQBUF, &newer);
+					if		(ret == EAGAIN)	{break;}															// no newer image
+					else if	(ret != 0)		{throw WebcamException("error while reading image", dev, ret);}	// error
+					if (newer.index >= buffers.size()) {throw WebcamException("buffer index out of range", dev);}
+					enqueue(buf.index);
+					buf = newer;
+					++numSkipped;
+				}
+			}
+
+			return true;
+
+		}
+
+	};
+
+}
+
+#endif // K_WEBCAMIO_STREAM_H
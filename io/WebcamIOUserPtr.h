@@ -0,0 +1,138 @@
+#ifndef K_WEBCAMIO_USERPTR_H
+#define K_WEBCAMIO_USERPTR_H
+
+#include "WebcamIOStream.h"
+#include <string>
+#include <vector>
+#include <linux/videodev2.h>
+#include <unistd.h>
+
+#include "../Debug.h"
+#include "WebcamException.h"
+
+namespace K {
+
+	/**
+	 * one caller-owned buffer the driver captures into (using DMA).
+	 * should be page-aligned and at least as large as one image.
+	 */
+	struct WebcamUserBuffer {
+		void* start;
+		size_t length;
+		WebcamUserBuffer(void* start, const size_t length) : start(start), length(length) {;}
+	};
+
+	/**
+	 * webcam-IO using User-Pointers.
+	 *
+	 * the driver writes directly into buffers allocated by the application
+	 * (e.g. hugepage-backed memory or already registered network buffers).
+	 * when no buffers are provided, page-aligned buffers are allocated
+	 * (and freed) by this class.
+	 *
+	 * in combination with Webcam::leaseImage() images never need to be copied.
+	 */
+	class WebcamIOUserPtr : public WebcamIOStream {
+
+	public:
+
+		/**
+		 * ctor
+		 * @param userBuffers the caller-owned buffers to capture into. they must outlive this IO.
+		 * if empty, the IO allocates its own buffers
+		 */
+		WebcamIOUserPtr(const int fd, const std::string& dev, const std::vector<WebcamUserBuffer>& userBuffers = std::vector<WebcamUserBuffer>()) :
+			WebcamIOStream(fd, dev, V4L2_MEMORY_USERPTR), userBuffers(userBuffers), ownsBuffers(false) {
+			;
+		}
+
+		/** dtor */
+		~WebcamIOUserPtr() {
+			freeOwnBuffers();
+		}
+
+		/** check whether the device supports capturing into user-pointers */
+		static bool isSupported(const int fd) {
+
+			// requesting 0 buffers is a no-op, but fails if the memory type is not supported
+			struct v4l2_requestbuffers req;
+			CLEAR(req);
+			req.count = 0;
+			req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			req.memory = V4L2_MEMORY_USERPTR;
+			return WebcamIO::xioctl(fd, VIDIOC_REQBUFS, &req) == 0;
+
+		}
+
+		void init(const uint32_t maxImageSize) override {
+
+			debug(dev, "\tinitializing USERPTR-IO");
+
+			this->maxImageSize = maxImageSize;
+
+			// use the configured number of buffers (4 by default) if the user did not provide some
+			// (you need at least 2/3 or you will have funny image glitches)
+			const uint32_t numWanted = (userBuffers.empty()) ? (numBuffersWanted) : ((uint32_t) userBuffers.size());
+			const uint32_t numBuffers = requestBuffers(numWanted);
+			if (!userBuffers.empty() && numBuffers > numWanted) {throw WebcamException("driver requires more buffers than provided", dev);}
+
+			debug(dev, "\tdriver accepted "+std::to_string(numBuffers)+" buffers");
+
+			buffers.resize(numBuffers);
+
+			// use the caller's buffers
+			if (!userBuffers.empty()) {
+				for (uint32_t i = 0; i < numBuffers; ++i) {
+					if (userBuffers[i].length < maxImageSize) {throw WebcamException("user buffer too small for one image", dev);}
+					buffers[i].start = userBuffers[i].start;
+					buffers[i].length = userBuffers[i].length;
+				}
+				return;
+			}
+
+			// allocate page-aligned buffers
+			const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+			const size_t length = (maxImageSize + pageSize - 1) / pageSize * pageSize;
+			ownsBuffers = true;
+			for (uint32_t i = 0; i < numBuffers; ++i) {
+				if (posix_memalign(&buffers[i].start, pageSize, length) != 0) {throw WebcamException("out of memory", dev);}
+				buffers[i].length = length;
+			}
+
+		}
+
+		void uninit() override {
+
+			debug(dev, "\tun-initializing USERPTR-IO");
+
+			// the driver must not access the buffers any more before freeing them
+			freeBuffers();
+			freeOwnBuffers();
+			buffers.clear();
+
+		}
+
+	protected:
+
+		const char* getName() const override {return "USERPTR-IO";}
+
+	private:
+
+		/** the buffers provided by the caller (if any) */
+		std::vector<WebcamUserBuffer> userBuffers;
+
+		/** were the buffers allocated by this class? */
+		bool ownsBuffers;
+
+		/** free all buffers allocated by this class (if any) */
+		void freeOwnBuffers() {
+			if (!ownsBuffers) {return;}
+			for (WebcamIOStreamBuffer& b : buffers) {free(b.start); b.start = nullptr;}
+			ownsBuffers = false;
+		}
+
+	};
+
+}
+
+#endif // K_WEBCAMIO_USERPTR_H
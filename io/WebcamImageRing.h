@@ -0,0 +1,314 @@
+#ifndef K_WEBCAMIMAGERING_H
+#define K_WEBCAMIMAGERING_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "../image/WebcamImage.h"
+#include "WebcamException.h"
+
+namespace K {
+
+	/** what to do when a new image arrives while the ring is full */
+	enum class RingOverflow {
+
+		/** replace the oldest (not yet consumed) image */
+		DROP_OLDEST,
+
+		/** discard the new image */
+		DROP_NEWEST,
+
+		/** let the producer wait until the consumer released a slot */
+		BLOCK,
+
+	};
+
+	/**
+	 * lock-free single-producer/single-consumer ring of preallocated WebcamImages.
+	 *
+	 * the producer writes directly into a slot (beginWrite() -> fill -> commitWrite())
+	 * and the consumer processes images directly within their slot
+	 * (acquire() -> process -> release()) so images are never copied.
+	 *
+	 * each slot carries one atomic word holding the sequence number of the image
+	 * it is meant for and its state. producer and consumer claim slots by CAS on
+	 * this word, which allows the producer to replace the oldest image (DROP_OLDEST)
+	 * while the consumer is working on another one.
+	 * the fast paths never lock. a mutex is only used to put a waiting
+	 * producer (BLOCK) or consumer (acquire with timeout) to sleep.
+	 *
+	 * close() wakes up both sides: waiting calls return nullptr until reopen().
+	 * images that are already within the ring can still be acquired.
+	 */
+	class WebcamImageRing {
+
+	public:
+
+		/**
+		 * ctor
+		 * @param numSlots the number of images the ring can hold
+		 * @param maxImageSize the number of bytes to preallocate for each slot
+		 * @param overflow what to do when the ring is full
+		 */
+		WebcamImageRing(const uint32_t numSlots, const uint32_t maxImageSize, const RingOverflow overflow) :
+			numSlots(numSlots), slots(new Slot[numSlots]), overflow(overflow),
+			head(0), numDropped(0), tail(0), readSeq(0), closed(false), producerWaiting(false), consumerWaiting(false) {
+
+			if (numSlots < 2) {throw WebcamException("the ring needs at least 2 slots", "WebcamImageRing");}
+
+			for (uint32_t i = 0; i < numSlots; ++i) {
+				slots[i].state.store(word(i, FREE));
+				slots[i].img.ensureSpace(maxImageSize);
+			}
+
+		}
+
+
+		/** -------------------------------- PRODUCER -------------------------------- */
+
+		/**
+		 * get the next slot to write an image into.
+		 * @param timeoutMS (BLOCK only) the max. time to wait for a free slot. -1 = forever
+		 * @return the slot to write into, or nullptr if the new image has to be dropped (or on timeout)
+		 */
+		WebcamImage* beginWrite(const int timeoutMS = -1) {
+
+			const uint64_t seq = tail;
+			Slot& slot = slots[seq % numSlots];
+
+			// slot free for this sequence? -> use it
+			if (claim(slot, word(seq, FREE), word(seq, WRITING))) {return &slot.img;}
+
+			// the slot still holds the image from one round ago -> ring is full
+			const uint64_t oldSeq = seq - numSlots;
+			switch (overflow) {
+
+				case RingOverflow::DROP_OLDEST:
+					// steal the oldest image, unless the consumer is currently reading it
+					if (claim(slot, word(oldSeq, READY), word(seq, WRITING))) {
+						advanceHead(oldSeq + 1);
+						++numDropped;
+						return &slot.img;
+					}
+					++numDropped;
+					return nullptr;
+
+				case RingOverflow::DROP_NEWEST:
+					++numDropped;
+					return nullptr;
+
+				case RingOverflow::BLOCK: {
+					std::unique_lock<std::mutex> lock(mutex);
+					producerWaiting = true;
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					bool ok = false;
+					auto isFree = [&] () {ok = claim(slot, word(seq, FREE), word(seq, WRITING)); return ok || closed.load();};
+					if (timeoutMS < 0)	{cond.wait(lock, isFree);}
+					else				{cond.wait_for(lock, std::chrono::milliseconds(timeoutMS), isFree);}
+					producerWaiting = false;
+					return (ok) ? (&slot.img) : (nullptr);
+				}
+
+			}
+
+			return nullptr;
+
+		}
+
+		/** publish the image written into the slot returned by beginWrite() */
+		void commitWrite() {
+			const uint64_t seq = tail++;
+			slots[seq % numSlots].state.store(word(seq, READY), std::memory_order_release);
+			wakeup();
+		}
+
+		/** give back the slot returned by beginWrite() without publishing an image */
+		void abortWrite() {
+			const uint64_t seq = tail;
+			slots[seq % numSlots].state.store(word(seq, FREE), std::memory_order_release);
+		}
+
+
+		/** -------------------------------- CONSUMER -------------------------------- */
+
+		/**
+		 * get the oldest image within the ring (without waiting).
+		 * the image belongs to the consumer until release() is called.
+		 * only one image can be acquired at a time.
+		 * @return the image or nullptr if the ring is empty
+		 */
+		WebcamImage* acquire() {
+
+			while (true) {
+
+				const uint64_t seq = head.load(std::memory_order_acquire);
+				Slot& slot = slots[seq % numSlots];
+				const uint64_t w = slot.state.load(std::memory_order_acquire);
+
+				// claim the image. might fail if the producer just replaced it (DROP_OLDEST)
+				if (w == word(seq, READY)) {
+					uint64_t expected = w;
+					if (slot.state.compare_exchange_strong(expected, word(seq, READING), std::memory_order_acq_rel)) {
+						head.store(seq + 1, std::memory_order_release);
+						readSeq = seq;
+						return &slot.img;
+					}
+					continue;
+				}
+
+				// the slot is not yet written (or not yet released) -> empty
+				if ((w >> 2) <= seq) {return nullptr;}
+
+				// slot already re-used (head is outdated) -> try again
+
+			}
+
+		}
+
+		/**
+		 * get the oldest image within the ring, waiting at most the given time
+		 * @param timeoutMS the max. time to wait. -1 = forever, 0 = do not wait
+		 * @return the image or nullptr on timeout (or if the ring is closed)
+		 */
+		WebcamImage* acquire(const int timeoutMS) {
+
+			WebcamImage* img = acquire();
+			if (img != nullptr || timeoutMS == 0) {return img;}
+
+			std::unique_lock<std::mutex> lock(mutex);
+			consumerWaiting = true;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			auto isReady = [&] () {img = acquire(); return img != nullptr || closed.load();};
+			if (timeoutMS < 0)	{cond.wait(lock, isReady);}
+			else				{cond.wait_for(lock, std::chrono::milliseconds(timeoutMS), isReady);}
+			consumerWaiting = false;
+			return img;
+
+		}
+
+		/** hand the image returned by acquire() back to the producer */
+		void release() {
+			const uint64_t seq = readSeq;
+			slots[seq % numSlots].state.store(word(seq + numSlots, FREE), std::memory_order_release);
+			wakeup();
+		}
+
+
+		/** -------------------------------- STATE -------------------------------- */
+
+		/** wake up (and do not wait any more within) all waiting beginWrite() / acquire() calls */
+		void close() {
+			closed = true;
+			std::lock_guard<std::mutex> lock(mutex);
+			cond.notify_all();
+		}
+
+		/** let beginWrite() / acquire() wait again */
+		void reopen() {
+			closed = false;
+		}
+
+		/** has close() been called? */
+		bool isClosed() const {return closed.load();}
+
+
+		/** -------------------------------- STATS -------------------------------- */
+
+		/** get the number of images that were dropped due to overflows */
+		uint64_t getNumDropped() const {return numDropped.load();}
+
+		/** get the number of slots */
+		uint32_t getNumSlots() const {return numSlots;}
+
+		/** get the overflow policy */
+		RingOverflow getOverflow() const {return overflow;}
+
+	private:
+
+		/** slot states */
+		static constexpr uint64_t FREE		= 0;
+		static constexpr uint64_t WRITING	= 1;
+		static constexpr uint64_t READY		= 2;
+		static constexpr uint64_t READING	= 3;
+
+		/** one slot within the ring */
+		struct Slot {
+
+			/** (sequence number << 2) | state */
+			std::atomic<uint64_t> state;
+
+			/** the preallocated image */
+			WebcamImage img;
+
+		};
+
+		/** combine sequence number and state */
+		static uint64_t word(const uint64_t seq, const uint64_t state) {return (seq << 2) | state;}
+
+		/** try to change the slot's word from "from" to "to" */
+		static bool claim(Slot& slot, uint64_t from, const uint64_t to) {
+			return slot.state.compare_exchange_strong(from, to, std::memory_order_acq_rel);
+		}
+
+		/**
+		 * move the head to the given sequence number (if not already beyond).
+		 * producer and consumer both advance the head and might do so out of order
+		 */
+		void advanceHead(const uint64_t seq) {
+			uint64_t cur = head.load(std::memory_order_acquire);
+			while (cur < seq && !head.compare_exchange_weak(cur, seq, std::memory_order_acq_rel)) {;}
+		}
+
+		/** wake up a waiting producer/consumer (if any) */
+		void wakeup() {
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!producerWaiting.load() && !consumerWaiting.load()) {return;}
+			std::lock_guard<std::mutex> lock(mutex);
+			cond.notify_all();
+		}
+
+
+		/** the number of slots */
+		const uint32_t numSlots;
+
+		/** all slots */
+		std::unique_ptr<Slot[]> slots;
+
+		/** what to do when the ring is full */
+		const RingOverflow overflow;
+
+		/** the sequence number of the next image to consume */
+		std::atomic<uint64_t> head;
+
+		/** the number of dropped images */
+		std::atomic<uint64_t> numDropped;
+
+		/** the sequence number of the next image to produce (producer only) */
+		uint64_t tail;
+
+		/** the sequence number of the currently acquired image (consumer only) */
+		uint64_t readSeq;
+
+		/** set by close() */
+		std::atomic<bool> closed;
+
+		/** only used to sleep while waiting */
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::atomic<bool> producerWaiting;
+		std::atomic<bool> consumerWaiting;
+
+		/** hidden copy ctor */
+		WebcamImageRing(const WebcamImageRing&);
+
+		/** hidden assignment operator */
+		WebcamImageRing& operator = (const WebcamImageRing&);
+
+	};
+
+}
+
+#endif // K_WEBCAMIMAGERING_H
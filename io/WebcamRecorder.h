@@ -0,0 +1,360 @@
+#ifndef K_WEBCAMRECORDER_H
+#define K_WEBCAMRECORDER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../image/WebcamImage.h"
+#include "../Debug.h"
+#include "WebcamException.h"
+#include "WebcamRecording.h"
+
+namespace K {
+
+	/**
+	 * records images (e.g. raw YUYV or MJPEG from Webcam::readImage())
+	 * at full rate into an indexed container (see WebcamRecording).
+	 *
+	 * record() only copies the image into one of several large, aligned buffers.
+	 * a writer thread writes each full buffer using one large write, bypassing
+	 * the page-cache (O_DIRECT) if the file-system supports it. otherwise
+	 * the written pages are dropped from the page-cache right after writing.
+	 * the capture thread thus never waits for the disk, unless all buffers
+	 * are full (see getNumStalls()).
+	 *
+	 * the index (offset, size, format, timestamp of each frame) is kept
+	 * in memory and appended to the file by close().
+	 *
+	 * usage:
+	 *	WebcamRecorder rec("cam.krec");
+	 *	while (...) {rec.record(cam.readImage());}
+	 *	rec.close();
+	 */
+	class WebcamRecorder {
+
+	public:
+
+		/** the alignment O_DIRECT needs for buffers, sizes and offsets */
+		static constexpr uint32_t BLOCK_SIZE = 4096;
+
+		/**
+		 * ctor. creates (or truncates) the file
+		 * @param file the recording to write
+		 * @param bufferSize the size of each buffer (= of each write). multiple of BLOCK_SIZE
+		 * @param numBuffers the number of buffers (at least 2: one to fill while the other is written)
+		 */
+		WebcamRecorder(const std::string& file, const uint32_t bufferSize = 4*1024*1024, const uint32_t numBuffers = 2) :
+			file(file), fd(-1), direct(true), bufferSize(bufferSize), active(0), pos(WebcamRecordingHeader::HEADER_SIZE),
+			toWrite(0), stopping(false), error(0), numStalls(0) {
+
+			if (bufferSize == 0 || bufferSize % BLOCK_SIZE != 0) {throw WebcamException("the buffer size must be a multiple of 4096", file);}
+			if (numBuffers < 2) {throw WebcamException("at least 2 buffers are needed", file);}
+
+			// not all file-systems (e.g. tmpfs) support O_DIRECT
+			fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT | O_CLOEXEC, 0644);
+			if (fd == -1 && errno == EINVAL) {
+				direct = false;
+				fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+			}
+			if (fd == -1) {throw WebcamException("error while creating recording", file, errno);}
+
+			buffers.resize(numBuffers);
+			for (Buffer& b : buffers) {
+				if (posix_memalign((void**) &b.data, BLOCK_SIZE, bufferSize) != 0) {freeBuffers(); ::close(fd); throw WebcamException("out of memory", file);}
+			}
+			buffers[0].offset = pos;
+
+			thread = std::thread(&WebcamRecorder::write, this);
+
+			debug(file, "recording " << ((direct) ? ("(O_DIRECT)") : ("(buffered)")) << " using " << numBuffers << " buffers of " << bufferSize << " bytes");
+
+		}
+
+		/** dtor. closes the recording (if not yet done) */
+		~WebcamRecorder() {
+			try {
+				close();
+			} catch (...) {
+				;
+			}
+		}
+
+		/** append one image to the recording */
+		void record(const WebcamImage& img) {
+
+			if (fd == -1) {throw WebcamException("recording already closed", file);}
+			traceScope("record", img.getSequence());
+
+			// each frame starts aligned
+			const uint64_t aligned = (pos + WebcamRecordingHeader::FRAME_ALIGNMENT - 1) / WebcamRecordingHeader::FRAME_ALIGNMENT * WebcamRecordingHeader::FRAME_ALIGNMENT;
+			append(nullptr, aligned - pos);
+
+			WebcamRecordingEntry e;
+			e.offset = pos;
+			e.timestampNS = img.getTimestampNS();
+			e.size = img.getNumBytes();
+			e.pixelFormat = img.getPixelFormat()._int;
+			e.width = img.getWidth();
+			e.height = img.getHeight();
+			e.sequence = img.getSequence();
+			e.flags = img.getFrameInfo().flags;
+			index.push_back(e);
+
+			append(img.getData(), img.getNumBytes());
+
+		}
+
+		/**
+		 * write the remaining data, the index and the header and close the file.
+		 * the recording is only readable after closing it!
+		 */
+		void close() {
+
+			if (fd == -1) {return;}
+
+			// the last (partially filled) buffer. write errors are reported below
+			const uint64_t dataEnd = alignBlock(pos);
+			try {
+				append(nullptr, dataEnd - pos);
+				if (pos > buffers[active].offset) {submit();}
+			} catch (...) {
+				;
+			}
+
+			// wait for the writer
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [this] {return toWrite == 0 || error != 0;});
+				stopping = true;
+			}
+			changed.notify_all();
+			thread.join();
+
+			try {
+
+				if (error != 0) {throw WebcamException("error while writing recording", file, error);}
+
+				// the index
+				const size_t indexSize = index.size() * sizeof(WebcamRecordingEntry);
+				writeAligned(index.data(), indexSize, dataEnd);
+
+				// the header
+				WebcamRecordingHeader header;
+				memset(&header, 0, sizeof(header));
+				memcpy(header.magic, "KREC", 4);
+				header.version = WebcamRecordingHeader::VERSION;
+				header.numFrames = index.size();
+				header.indexOffset = dataEnd;
+				header.entrySize = sizeof(WebcamRecordingEntry);
+				writeAligned(&header, sizeof(header), 0);
+
+				if (fdatasync(fd) != 0) {throw WebcamException("error while syncing recording", file, errno);}
+
+			} catch (...) {
+				::close(fd);
+				fd = -1;
+				freeBuffers();
+				throw;
+			}
+
+			if (::close(fd) != 0) {fd = -1; freeBuffers(); throw WebcamException("error while closing recording", file, errno);}
+			fd = -1;
+			freeBuffers();
+
+			debug(file, "recorded " << index.size() << " frames, " << dataEnd << " bytes");
+
+		}
+
+		/** get the number of frames recorded so far */
+		uint64_t getNumFrames() const {return index.size();}
+
+		/** get the number of bytes recorded so far */
+		uint64_t getNumBytes() const {return pos;}
+
+		/** get the number of times record() had to wait for the disk, as all buffers were full */
+		uint64_t getNumStalls() const {return numStalls;}
+
+		/** is the page-cache bypassed (O_DIRECT)? */
+		bool isDirect() const {return direct;}
+
+	private:
+
+		/** one buffer of bufferSize bytes, written at the given file offset */
+		struct Buffer {
+			uint8_t* data;
+			uint64_t offset;
+			uint32_t length;
+			bool pending;
+			Buffer() : data(nullptr), offset(0), length(0), pending(false) {;}
+		};
+
+		/** the recording's file name */
+		std::string file;
+
+		/** the recording's file-descriptor */
+		int fd;
+
+		/** opened with O_DIRECT? */
+		bool direct;
+
+		/** the size of each buffer */
+		const uint32_t bufferSize;
+
+		/** the buffers, used round-robin */
+		std::vector<Buffer> buffers;
+
+		/** the buffer currently filled by record() */
+		uint32_t active;
+
+		/** the file offset of the next byte to record */
+		uint64_t pos;
+
+		/** the index of all recorded frames */
+		std::vector<WebcamRecordingEntry> index;
+
+		/** the writer thread */
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable changed;
+
+		/** the number of buffers waiting to be written */
+		uint32_t toWrite;
+
+		/** stop the writer thread? */
+		bool stopping;
+
+		/** the writer's error number (if any) */
+		int error;
+
+		/** the number of times record() had to wait for a free buffer */
+		uint64_t numStalls;
+
+
+		/** round up to the next BLOCK_SIZE */
+		static uint64_t alignBlock(const uint64_t val) {
+			return (val + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+		}
+
+		/** append the given bytes (zeros if src is nullptr) to the active buffer(s) */
+		void append(const uint8_t* src, uint64_t num) {
+			while (num > 0) {
+				Buffer& b = buffers[active];
+				const uint64_t used = pos - b.offset;
+				const uint64_t n = std::min<uint64_t>(num, bufferSize - used);
+				if (src) {memcpy(b.data + used, src, n); src += n;} else {memset(b.data + used, 0, n);}
+				pos += n;
+				num -= n;
+				if (pos - b.offset == bufferSize) {submit();}
+			}
+		}
+
+		/** hand the active buffer to the writer thread and continue with the next one */
+		void submit() {
+
+			std::unique_lock<std::mutex> lock(mutex);
+			if (error != 0) {throw WebcamException("error while writing recording", file, error);}
+
+			buffers[active].length = (uint32_t) (pos - buffers[active].offset);
+			buffers[active].pending = true;
+			++toWrite;
+			changed.notify_all();
+
+			// the next buffer might still be written
+			active = (active + 1) % (uint32_t) buffers.size();
+			if (buffers[active].pending) {
+				++numStalls;
+				debugVerbose(file, "recording stalled. the disk is too slow");
+				traceEvent("record.stall", numStalls, pos);
+				changed.wait(lock, [this] {return !buffers[active].pending || error != 0;});
+				if (error != 0) {throw WebcamException("error while writing recording", file, error);}
+			}
+			buffers[active].offset = pos;
+
+		}
+
+		/** the writer thread: write all pending buffers in order */
+		void write() {
+
+			uint32_t next = 0;
+			std::unique_lock<std::mutex> lock(mutex);
+
+			while (true) {
+
+				changed.wait(lock, [this, next] {return buffers[next].pending || stopping;});
+				if (!buffers[next].pending) {return;}
+
+				// the buffer is not touched by record() while pending
+				Buffer& b = buffers[next];
+				lock.unlock();
+				const int err = writeAt(b.data, b.length, b.offset);
+				lock.lock();
+
+				if (err != 0) {error = err; changed.notify_all(); return;}
+				b.pending = false;
+				--toWrite;
+				next = (next + 1) % (uint32_t) buffers.size();
+				changed.notify_all();
+
+			}
+
+		}
+
+		/**
+		 * write the given (aligned) data at the given (aligned) offset.
+		 * without O_DIRECT, the written pages are dropped from the page-cache
+		 * @return 0 or the error number
+		 */
+		int writeAt(const uint8_t* data, const size_t length, const uint64_t offset) {
+			traceScope("record.write", length);
+			size_t done = 0;
+			while (done < length) {
+				const ssize_t n = ::pwrite(fd, data + done, length - done, (off_t) (offset + done));
+				if (n < 0 && errno == EINTR) {continue;}
+				if (n <= 0) {return (n < 0) ? (errno) : (EIO);}
+				done += (size_t) n;
+			}
+			if (!direct) {
+				sync_file_range(fd, (off_t) offset, (off_t) length, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+				posix_fadvise(fd, (off_t) offset, (off_t) length, POSIX_FADV_DONTNEED);
+			}
+			return 0;
+		}
+
+		/** write arbitrary data at the given (aligned) offset, padded to BLOCK_SIZE */
+		void writeAligned(const void* data, const size_t length, const uint64_t offset) {
+			const size_t padded = (size_t) alignBlock(length);
+			if (padded == 0) {return;}
+			uint8_t* tmp;
+			if (posix_memalign((void**) &tmp, BLOCK_SIZE, padded) != 0) {throw WebcamException("out of memory", file);}
+			memcpy(tmp, data, length);
+			memset(tmp + length, 0, padded - length);
+			const int err = writeAt(tmp, padded, offset);
+			free(tmp);
+			if (err != 0) {throw WebcamException("error while writing recording", file, err);}
+		}
+
+		/** free all buffers */
+		void freeBuffers() {
+			for (Buffer& b : buffers) {free(b.data); b.data = nullptr;}
+		}
+
+		/** hidden copy ctor */
+		WebcamRecorder(const WebcamRecorder&);
+
+		/** hidden assignment operator */
+		WebcamRecorder& operator = (const WebcamRecorder&);
+
+	};
+
+}
+
+#endif // K_WEBCAMRECORDER_H
@@ -0,0 +1,219 @@
+#ifndef K_WEBCAMRECORDING_H
+#define K_WEBCAMRECORDING_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../image/WebcamImage.h"
+#include "../Debug.h"
+#include "WebcamException.h"
+
+namespace K {
+
+	/**
+	 * the layout of a recording (see WebcamRecorder), native byte order:
+	 *
+	 *	[header, padded to HEADER_SIZE]
+	 *	[frame][frame]...		each frame starts at a multiple of FRAME_ALIGNMENT
+	 *	[index: numFrames * WebcamRecordingEntry]
+	 *
+	 * the header (and thus the index) is written when the recording is closed.
+	 */
+	struct WebcamRecordingHeader {
+
+		/** "KREC" */
+		char magic[4];
+
+		/** the file-format's version (1) */
+		uint32_t version;
+
+		/** the number of frames (and index entries) */
+		uint64_t numFrames;
+
+		/** the file offset of the index */
+		uint64_t indexOffset;
+
+		/** sizeof(WebcamRecordingEntry) */
+		uint32_t entrySize;
+
+		uint32_t reserved;
+
+		/** current file-format version */
+		static constexpr uint32_t VERSION = 1;
+
+		/** the space reserved for the header. the first frame starts here */
+		static constexpr uint32_t HEADER_SIZE = 4096;
+
+		/** the alignment of each frame's data within the file */
+		static constexpr uint32_t FRAME_ALIGNMENT = 64;
+
+	};
+
+	/** one frame within the recording's index */
+	struct WebcamRecordingEntry {
+
+		/** the file offset of the frame's data */
+		uint64_t offset;
+
+		/** the frame's capture time (see WebcamFrameInfo) */
+		uint64_t timestampNS;
+
+		/** the frame's size in bytes */
+		uint32_t size;
+
+		/** the frame's format */
+		uint32_t pixelFormat;
+		uint32_t width;
+		uint32_t height;
+
+		/** the driver's sequence number and buffer flags (see WebcamFrameInfo) */
+		uint32_t sequence;
+		uint32_t flags;
+
+	};
+
+	/**
+	 * read access to a recording written by the WebcamRecorder.
+	 *
+	 * the whole file is memory-mapped (read-only), thus each frame can be
+	 * accessed in O(1) using the index, without copying it.
+	 * seeking by time uses a binary search on the (monotonic) timestamps.
+	 */
+	class WebcamRecording {
+
+	public:
+
+		/**
+		 * ctor. opens and maps the recording
+		 * @param file the recording to open
+		 */
+		WebcamRecording(const std::string& file) : file(file), fd(-1), map(nullptr), mapSize(0), header(nullptr), index(nullptr) {
+			try {
+				open();
+			} catch (...) {
+				close();
+				throw;
+			}
+			debug(file, "opened recording with " << getNumFrames() << " frames");
+		}
+
+		/** dtor */
+		~WebcamRecording() {
+			close();
+		}
+
+		/** get the number of frames within the recording */
+		uint64_t getNumFrames() const {return header->numFrames;}
+
+		/** get the index entry (offset, size, format, timestamp, ...) of the given frame */
+		const WebcamRecordingEntry& getEntry(const uint64_t idx) const {
+			if (idx >= header->numFrames) {throw WebcamException("frame index out of range", file);}
+			return index[idx];
+		}
+
+		/** get the data of the given frame. valid as long as the recording is open */
+		const uint8_t* getData(const uint64_t idx) const {
+			return map + getEntry(idx).offset;
+		}
+
+		/**
+		 * let the given image point to the given frame (no copy).
+		 * the image is valid as long as the recording is open and is read-only:
+		 * writing into its data crashes. use a converter (or a copy) to modify it
+		 */
+		void getImage(const uint64_t idx, WebcamImage& dst) const {
+			const WebcamRecordingEntry& e = getEntry(idx);
+			dst.data.wrap(map + e.offset, e.size);
+			dst.setParameters(e.width, e.height, PixelFormat(e.pixelFormat), e.size);
+			WebcamFrameInfo info;
+			info.timestampNS = e.timestampNS;
+			info.sequence = e.sequence;
+			info.flags = e.flags;
+			dst.setFrameInfo(info);
+		}
+
+		/**
+		 * get the index of the first frame captured at or after the given time.
+		 * getNumFrames() if there is none
+		 */
+		uint64_t findFrame(const uint64_t timestampNS) const {
+			uint64_t lo = 0;
+			uint64_t hi = header->numFrames;
+			while (lo < hi) {
+				const uint64_t mid = lo + (hi - lo) / 2;
+				if (index[mid].timestampNS < timestampNS) {lo = mid + 1;} else {hi = mid;}
+			}
+			return lo;
+		}
+
+	private:
+
+		/** the recording's file name */
+		std::string file;
+
+		/** the recording's file-descriptor */
+		int fd;
+
+		/** the mapped recording */
+		uint8_t* map;
+		size_t mapSize;
+
+		/** pointers into the mapping */
+		const WebcamRecordingHeader* header;
+		const WebcamRecordingEntry* index;
+
+
+		/** open and map the file, check the header and the index */
+		void open() {
+
+			fd = ::open(file.c_str(), O_RDONLY);
+			if (fd == -1) {throw WebcamException("error while opening recording", file, errno);}
+
+			struct stat st;
+			if (fstat(fd, &st) != 0) {throw WebcamException("error while reading recording's size", file, errno);}
+			mapSize = (size_t) st.st_size;
+			if (mapSize < WebcamRecordingHeader::HEADER_SIZE) {throw WebcamException("recording is too small", file);}
+
+			// read-only: images pointing into the file must not modify it (see getImage())
+			map = (uint8_t*) mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (map == MAP_FAILED) {map = nullptr; throw WebcamException("error while mapping recording", file, errno);}
+
+			header = (const WebcamRecordingHeader*) map;
+			if (memcmp(header->magic, "KREC", 4) != 0)						{throw WebcamException("not a recording (or not closed properly)", file);}
+			if (header->version != WebcamRecordingHeader::VERSION)			{throw WebcamException("unsupported recording version", file);}
+			if (header->entrySize != sizeof(WebcamRecordingEntry))			{throw WebcamException("invalid index entry size", file);}
+			if (header->indexOffset < WebcamRecordingHeader::HEADER_SIZE ||
+				header->indexOffset > mapSize ||
+				header->numFrames > (mapSize - header->indexOffset) / sizeof(WebcamRecordingEntry)) {
+				throw WebcamException("invalid index", file);
+			}
+
+			index = (const WebcamRecordingEntry*) (map + header->indexOffset);
+			for (uint64_t i = 0; i < header->numFrames; ++i) {
+				if (index[i].offset < WebcamRecordingHeader::HEADER_SIZE || index[i].offset + index[i].size > header->indexOffset) {throw WebcamException("invalid index entry", file);}
+			}
+
+		}
+
+		/** unmap and close the file */
+		void close() {
+			if (map) {munmap(map, mapSize); map = nullptr;}
+			if (fd != -1) {::close(fd); fd = -1;}
+		}
+
+		/** hidden copy ctor */
+		WebcamRecording(const WebcamRecording&);
+
+		/** hidden assignment operator */
+		WebcamRecording& operator = (const WebcamRecording&);
+
+	};
+
+}
+
+#endif // K_WEBCAMRECORDING_H
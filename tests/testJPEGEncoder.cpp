@@ -0,0 +1,119 @@
+/**
+ * checks the JPEGEncoder using noise (the worst case for the output's size)
+ * at quality 100 and heights that are no multiple of the MCU's height.
+ * the parallel (strip-wise) encoding must work whenever the serial one does
+ * and decode to the same image.
+ *
+ * compile (from the repository's root):
+ *		g++ -std=c++11 -O2 tests/testJPEGEncoder.cpp -o testJPEGEncoder -ljpeg -pthread
+ *
+ * usage:
+ *		./testJPEGEncoder		returns 0 if all checks passed
+ */
+
+#define K_LOG_LEVEL K_LOG_NONE
+
+#include "../Debug.h"
+#include "../image/WebcamImage.h"
+#include "../image/ThreadPool.h"
+#include "../image/converters/JPEG.h"
+#include "../image/converters/JPEGDecoder.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace K;
+
+/** deterministic pseudo-random numbers */
+struct XorShift {
+	uint32_t state;
+	XorShift(const uint32_t seed) : state(seed) {;}
+	uint32_t next() {state ^= state << 13; state ^= state >> 17; state ^= state << 5; return state;}
+};
+
+/** get the number of bytes of an image with the given size and format */
+static uint32_t getNumBytes(const uint32_t fmt, const uint32_t w, const uint32_t h) {
+	switch (fmt) {
+		case V4L2_PIX_FMT_GREY:		return w*h;
+		case V4L2_PIX_FMT_YUYV:		return w*h*2;
+		case V4L2_PIX_FMT_YUV420:	return w*h + 2 * ((w+1)/2) * ((h+1)/2);
+		default:					return w*h*3;
+	}
+}
+
+int main() {
+
+	uint32_t numChecks = 0;
+	uint32_t numFailed = 0;
+
+	JPEGEncoder enc;
+	JPEGDecoder dec;
+	ThreadPool pool(4);
+	XorShift rnd(1234);
+
+	for (const uint32_t fmt : {V4L2_PIX_FMT_RGB24, V4L2_PIX_FMT_GREY, V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_YUYV}) {
+		for (const uint32_t w : {1280u, 34u}) {
+			for (const uint32_t h : {1u, 7u, 9u, 17u, 705u, 721u, 1081u}) {
+				for (const uint8_t quality : {100, 85}) {
+					for (const uint32_t stripeHeight : {0u, 16u, 40u}) {
+
+						++numChecks;
+
+						const uint32_t size = getNumBytes(fmt, w, h);
+						WebcamImage src;
+						src.ensureSpace(size);
+						src.setParameters(w, h, PixelFormat(fmt), size);
+						for (uint32_t i = 0; i < size; ++i) {src.getData()[i] = (uint8_t) rnd.next();}
+
+						WebcamImage serial, parallel, rgbSerial, rgbParallel;
+						pool.setStripeHeight(stripeHeight);
+
+						try {
+							enc.encode(src, serial, quality);
+							enc.encode(src, parallel, quality, &pool);
+							dec.decodeRGB(serial, rgbSerial);
+							dec.decodeRGB(parallel, rgbParallel);
+						} catch (const std::exception& e) {
+							printf("FAILED: %s %ux%u q%u stripes of %u rows: %s\n", PixelFormat(fmt).asString().c_str(), w, h, (uint32_t) quality, stripeHeight, e.what());
+							++numFailed;
+							continue;
+						}
+
+						if (rgbParallel.getWidth() != w || rgbParallel.getHeight() != h ||
+							rgbSerial.getNumBytes() != rgbParallel.getNumBytes() ||
+							memcmp(rgbSerial.getData(), rgbParallel.getData(), rgbSerial.getNumBytes()) != 0) {
+							printf("FAILED: %s %ux%u q%u stripes of %u rows: serial and parallel differ\n", PixelFormat(fmt).asString().c_str(), w, h, (uint32_t) quality, stripeHeight);
+							++numFailed;
+						}
+
+					}
+				}
+			}
+		}
+	}
+
+	// YUYV needs at least 2 pixels (one Cb/Cr pair) per row. narrower images are rejected
+	for (const uint32_t w : {1u, 2u}) {
+		++numChecks;
+		const uint32_t size = getNumBytes(V4L2_PIX_FMT_YUYV, w, 8);
+		WebcamImage src, jpeg, rgb;
+		src.ensureSpace(size);
+		src.setParameters(w, 8, PixelFormat(V4L2_PIX_FMT_YUYV), size);
+		memset(src.getData(), 128, size);
+		bool rejected = false;
+		try {
+			enc.encode(src, jpeg, 85);
+			dec.decodeRGB(jpeg, rgb);
+		} catch (const ConverterException&) {
+			rejected = true;
+		}
+		if (rejected != (w < 2) || (!rejected && rgb.getWidth() != w)) {
+			printf("FAILED: YUYV %ux8: %s\n", w, (rejected) ? ("rejected") : ("not rejected"));
+			++numFailed;
+		}
+	}
+
+	printf("%u of %u checks passed\n", numChecks - numFailed, numChecks);
+	return (numFailed == 0) ? (0) : (1);
+
+}
@@ -0,0 +1,224 @@
+/**
+ * checks the lock-free WebcamImageRing (order, overflow policies, timeouts, close)
+ * and the WebcamCaptureThread on top of it: an error thrown while capturing
+ * must reach the consumer, and after restarting the thread, images must
+ * flow again (no slot may stay claimed by the failed capture).
+ *
+ * compile (from the repository's root):
+ *		g++ -std=c++11 -O2 tests/testWebcamImageRing.cpp -o testWebcamImageRing -pthread
+ *
+ * usage:
+ *		./testWebcamImageRing	returns 0 if all checks passed
+ */
+
+#define K_LOG_LEVEL K_LOG_NONE
+
+#include "../Debug.h"
+#include "../io/WebcamImageRing.h"
+#include "../io/WebcamCaptureThread.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+using namespace K;
+
+static uint32_t numChecks = 0;
+static uint32_t numPassed = 0;
+
+static void check(const bool ok, const char* what, const char* policy) {
+	++numChecks;
+	if (ok) {++numPassed; return;}
+	printf("FAILED: %s (%s)\n", what, policy);
+}
+
+static const char* getName(const RingOverflow overflow) {
+	switch (overflow) {
+		case RingOverflow::DROP_OLDEST:	return "DROP_OLDEST";
+		case RingOverflow::DROP_NEWEST:	return "DROP_NEWEST";
+		case RingOverflow::BLOCK:		return "BLOCK";
+	}
+	return "?";
+}
+
+/** write one image holding the given number */
+static bool write(WebcamImageRing& ring, const uint32_t nr, const int timeoutMS = 0) {
+	WebcamImage* img = ring.beginWrite(timeoutMS);
+	if (img == nullptr) {return false;}
+	img->ensureSpace(sizeof(nr));
+	memcpy(img->getData(), &nr, sizeof(nr));
+	ring.commitWrite();
+	return true;
+}
+
+/** get the number stored within the image */
+static uint32_t getNr(const WebcamImage* img) {
+	uint32_t nr;
+	memcpy(&nr, img->getData(), sizeof(nr));
+	return nr;
+}
+
+/** the images arrive in order and released slots are re-used */
+static void testOrder(const RingOverflow overflow) {
+	const char* name = getName(overflow);
+	WebcamImageRing ring(4, 64, overflow);
+	check(ring.acquire() == nullptr, "empty ring returns an image", name);
+	uint32_t next = 0;
+	for (uint32_t round = 0; round < 10; ++round) {
+		for (uint32_t i = 0; i < 3; ++i) {check(write(ring, round*3+i), "write into non-full ring failed", name);}
+		for (uint32_t i = 0; i < 3; ++i) {
+			WebcamImage* img = ring.acquire();
+			check(img != nullptr, "missing image", name);
+			if (img == nullptr) {return;}
+			check(getNr(img) == next++, "wrong order", name);
+			ring.release();
+		}
+		check(ring.acquire() == nullptr, "drained ring returns an image", name);
+	}
+	check(ring.getNumDropped() == 0, "images dropped without overflow", name);
+}
+
+/** a full ring drops the oldest / the newest image */
+static void testDrop(const RingOverflow overflow) {
+	const char* name = getName(overflow);
+	WebcamImageRing ring(4, 64, overflow);
+	for (uint32_t i = 0; i < 6; ++i) {write(ring, i);}
+	check(ring.getNumDropped() == 2, "wrong number of dropped images", name);
+	const uint32_t first = (overflow == RingOverflow::DROP_OLDEST) ? (2) : (0);
+	for (uint32_t i = 0; i < 4; ++i) {
+		WebcamImage* img = ring.acquire();
+		check(img != nullptr && getNr(img) == first + i, "wrong image after overflow", name);
+		if (img) {ring.release();}
+	}
+	check(ring.acquire() == nullptr, "too many images after overflow", name);
+}
+
+/** a full BLOCK ring times out, and waits until the consumer releases a slot */
+static void testBlock() {
+	const char* name = "BLOCK";
+	WebcamImageRing ring(2, 64, RingOverflow::BLOCK);
+	write(ring, 0); write(ring, 1);
+	check(!write(ring, 2, 20), "write into full ring did not time out", name);
+	std::thread consumer([&] () {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		if (ring.acquire()) {ring.release();}
+	});
+	check(write(ring, 2, -1), "blocked write was not woken up", name);
+	consumer.join();
+	check(ring.getNumDropped() == 0, "BLOCK dropped images", name);
+}
+
+/** close() wakes up a consumer waiting forever, reopen() lets it wait again */
+static void testClose() {
+	const char* name = "close";
+	WebcamImageRing ring(2, 64, RingOverflow::DROP_OLDEST);
+	std::thread closer([&] () {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		ring.close();
+	});
+	check(ring.acquire(-1) == nullptr, "closed ring returns an image", name);
+	closer.join();
+	check(ring.isClosed(), "ring not closed", name);
+	ring.reopen();
+	write(ring, 7);
+	WebcamImage* img = ring.acquire(-1);
+	check(img != nullptr && getNr(img) == 7, "reopened ring does not work", name);
+}
+
+/** numbers the images and throws once the given image is reached */
+class FailingCapture : public WebcamCaptureThread {
+
+public:
+
+	FailingCapture(Webcam& cam, const RingOverflow overflow) : WebcamCaptureThread(cam, 3, overflow), nr(0), failAt(-1) {;}
+
+	~FailingCapture() {
+		try {stop();} catch (...) {;}
+	}
+
+	/** throw when capturing the n-th next image */
+	void failIn(const int n) {failAt = (int) nr + n;}
+
+protected:
+
+	bool capture(WebcamImage& dst, const int timeoutMS) override {
+		(void) timeoutMS;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		if ((int) nr == failAt) {failAt = -1; throw std::runtime_error("capture failed");}
+		dst.ensureSpace(sizeof(uint32_t));
+		const uint32_t cur = nr++;
+		memcpy(dst.getData(), &cur, sizeof(cur));
+		return true;
+	}
+
+private:
+
+	std::atomic<uint32_t> nr;
+	std::atomic<int> failAt;
+
+};
+
+/** an error while capturing reaches the consumer, and a restarted thread captures again */
+static void testCaptureError(const RingOverflow overflow) {
+
+	const char* name = getName(overflow);
+	Webcam cam("test");
+	FailingCapture capture(cam, overflow);
+
+	for (int run = 0; run < 3; ++run) {
+
+		capture.failIn(10);
+		capture.start();
+
+		// consume until the error arrives
+		bool thrown = false;
+		int last = -1;
+		for (int i = 0; i < 50 && !thrown; ++i) {
+			try {
+				WebcamImage* img = capture.acquire(200);
+				if (img == nullptr) {continue;}
+				check((int) getNr(img) > last, "images out of order", name);
+				last = getNr(img);
+				capture.release();
+			} catch (std::runtime_error&) {
+				thrown = true;
+			}
+		}
+		check(thrown, "capture error not rethrown", name);
+		capture.stop();
+
+		// restart: images must flow again
+		capture.start();
+		int numImages = 0;
+		for (int i = 0; i < 50 && numImages < 10; ++i) {
+			WebcamImage* img = capture.acquire(200);
+			if (img == nullptr) {continue;}
+			check((int) getNr(img) > last, "old image after restart", name);
+			last = getNr(img);
+			++numImages;
+			capture.release();
+		}
+		check(numImages == 10, "no images after restarting the capture thread", name);
+		capture.stop();
+
+	}
+
+}
+
+int main() {
+
+	const RingOverflow policies[] = {RingOverflow::DROP_OLDEST, RingOverflow::DROP_NEWEST, RingOverflow::BLOCK};
+
+	for (const RingOverflow overflow : policies) {testOrder(overflow);}
+	testDrop(RingOverflow::DROP_OLDEST);
+	testDrop(RingOverflow::DROP_NEWEST);
+	testBlock();
+	testClose();
+	for (const RingOverflow overflow : policies) {testCaptureError(overflow);}
+
+	printf("%u of %u checks passed\n", numPassed, numChecks);
+	return (numPassed == numChecks) ? (0) : (1);
+
+}
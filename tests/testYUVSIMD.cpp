@@ -0,0 +1,119 @@
+/**
+ * compares the SIMD kernels of the YUYV and YUV420 -> RGB24 converters
+ * against the scalar reference, for every SIMD level the CPU supports.
+ * the results must be identical, including odd widths, widths that are
+ * no multiple of the vector sizes (16 / 32 pixels) and odd heights.
+ *
+ * compile (from the repository's root):
+ *		g++ -std=c++11 -O2 tests/testYUVSIMD.cpp -o testYUVSIMD -pthread
+ *
+ * usage:
+ *		./testYUVSIMD			returns 0 if all checks passed
+ */
+
+#define K_LOG_LEVEL K_LOG_NONE
+
+#include "../Debug.h"
+#include "../image/WebcamImage.h"
+#include "../image/converters/SIMD.h"
+#include "../image/converters/YUYV_RGB24.h"
+#include "../image/converters/YUV420_RGB24.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace K;
+
+/** deterministic pseudo-random numbers */
+struct XorShift {
+	uint32_t state;
+	XorShift(const uint32_t seed) : state(seed) {;}
+	uint32_t next() {state ^= state << 13; state ^= state >> 17; state ^= state << 5; return state;}
+};
+
+/** a converter to check */
+struct Converter {
+	const char* name;
+	uint32_t format;
+	void (*convert) (const WebcamImage& src, WebcamImage& dst, ThreadPool* pool);
+	uint32_t (*getNumBytes) (const uint32_t w, const uint32_t h);
+};
+
+static const char* getName(const SIMDLevel level) {
+	switch (level) {
+		case SIMDLevel::SCALAR:	return "scalar";
+		case SIMDLevel::SSE2:	return "sse2";
+		case SIMDLevel::SSSE3:	return "ssse3";
+		case SIMDLevel::AVX2:	return "avx2";
+	}
+	return "?";
+}
+
+int main() {
+
+	const Converter converters[] = {
+		{"YUYV -> RGB24",	V4L2_PIX_FMT_YUYV,		convertYUYVtoRGB24,		[] (const uint32_t w, const uint32_t h) {return w*h*2;}},
+		{"YUV420 -> RGB24",	V4L2_PIX_FMT_YUV420,	convertYUV420toRGB24,	[] (const uint32_t w, const uint32_t h) {return w*h + 2 * ((w+1)/2) * ((h+1)/2);}},
+	};
+
+	// all widths up to 2*32+, around multiples of the vector sizes and some real ones
+	std::vector<uint32_t> widths;
+	for (uint32_t w = 1; w <= 80; ++w) {widths.push_back(w);}
+	for (const uint32_t w : {95u, 96u, 97u, 127u, 128u, 129u, 255u, 256u, 257u, 639u, 640u, 641u, 1279u, 1280u}) {widths.push_back(w);}
+	const uint32_t heights[] = {1, 2, 3, 4, 7};
+
+	const SIMDLevel best = detectSIMDLevel();
+	uint32_t numChecks = 0;
+	uint32_t numFailed = 0;
+	XorShift rnd(1234);
+
+	for (const Converter& conv : converters) {
+		for (const uint32_t w : widths) {
+			for (const uint32_t h : heights) {
+
+				// YUYV with an odd width reads the last pixel's chroma beyond the row -> some padding
+				const uint32_t size = conv.getNumBytes(w, h);
+				WebcamImage src;
+				src.ensureSpace(size + 64);
+				src.setParameters(w, h, PixelFormat(conv.format), size);
+				for (uint32_t i = 0; i < size + 64; ++i) {src.getData()[i] = (uint8_t) rnd.next();}
+
+				WebcamImage ref;
+				setSIMDLevel(SIMDLevel::SCALAR);
+				conv.convert(src, ref, nullptr);
+
+				for (const SIMDLevel level : {SIMDLevel::SSE2, SIMDLevel::SSSE3, SIMDLevel::AVX2}) {
+
+					if (level > best) {continue;}
+					++numChecks;
+
+					WebcamImage dst;
+					setSIMDLevel(level);
+					conv.convert(src, dst, nullptr);
+
+					if (dst.getNumBytes() != ref.getNumBytes()) {
+						printf("FAILED: %s %s %ux%u: wrong size\n", conv.name, getName(level), w, h);
+						++numFailed;
+						continue;
+					}
+
+					for (uint32_t i = 0; i < ref.getNumBytes(); ++i) {
+						if (dst.getData()[i] == ref.getData()[i]) {continue;}
+						const uint32_t px = i / 3;
+						printf("FAILED: %s %s %ux%u: pixel (%u, %u) differs\n", conv.name, getName(level), w, h, px % w, px / w);
+						++numFailed;
+						break;
+					}
+
+				}
+
+			}
+		}
+	}
+
+	setSIMDLevel(best);
+	printf("%u of %u checks passed (best SIMD level: %s)\n", numChecks - numFailed, numChecks, getName(best));
+	return (numFailed == 0) ? (0) : (1);
+
+}
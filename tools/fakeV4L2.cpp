@@ -0,0 +1,674 @@
+/**
+ * LD_PRELOAD shim emulating a V4L2 streaming capture device.
+ *
+ * intercepts open() / close() / ioctl() / mmap() for one fake device path
+ * and answers them like a (memory-mapped, streaming) V4L2 driver would.
+ * the driver's buffers live within a memfd (shared memory) which the
+ * application maps just like the buffers of a real device.
+ * everything else is passed on to the real functions.
+ *
+ * this allows exercising (and profiling) Webcam, WebcamIOMMAP and friends,
+ * including queue starvation, dropped frames and spurious wakeups,
+ * on machines without a camera.
+ *
+ * the device's file-descriptor is an eventfd that is readable whenever a
+ * captured frame waits to be dequeued, thus poll() / epoll / select() work
+ * natively and do not need to be intercepted.
+ *
+ * compile (from the repository's root):
+ *		g++ -std=c++11 -O2 -shared -fPIC tools/fakeV4L2.cpp -o libfakeV4L2.so -ldl -pthread
+ *
+ * usage:
+ *		KAMERA_FAKE_FPS=60 LD_PRELOAD=./libfakeV4L2.so ./app		(app opens /dev/video-fake)
+ *
+ * configuration (environment variables):
+ *		KAMERA_FAKE_DEVICE		the path to emulate (default: /dev/video-fake)
+ *		KAMERA_FAKE_FORMATS		formats and frame sizes, e.g. "YUYV:640x480,1280x720;GREY:640x480" (default)
+ *								supported: YUYV, GREY, RGB3, YU12
+ *		KAMERA_FAKE_FPS			frames per second. 0 = capture whenever a buffer is queued (default: 30)
+ *		KAMERA_FAKE_MIN_BUFFERS	the min. number of buffers REQBUFS grants (default: 2)
+ *		KAMERA_FAKE_MAX_BUFFERS	the max. number of buffers REQBUFS grants (default: 8)
+ *		KAMERA_FAKE_EAGAIN		probability [0:1] for DQBUF to fail with EAGAIN although a frame is ready (default: 0)
+ *		KAMERA_FAKE_DROP		probability [0:1] for a captured frame to be dropped (default: 0)
+ *		KAMERA_FAKE_ERROR		probability [0:1] for a frame to be flagged with V4L2_BUF_FLAG_ERROR (default: 0)
+ *
+ * like a real driver, frames are dropped (and the sequence number still increases)
+ * when the application did not queue any buffer to capture into (starvation).
+ * each frame is filled with (sequence & 0xFF) and starts with the 32-bit sequence number.
+ * the statistics are written to stderr when the device is closed.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+namespace {
+
+	/** one supported pixel format and its frame sizes */
+	struct FakeFormat {
+		uint32_t fourcc;
+		std::vector<std::pair<uint32_t, uint32_t>> sizes;
+	};
+
+	/** the emulated device's configuration */
+	struct FakeConfig {
+
+		std::string device;
+		std::vector<FakeFormat> formats;
+		double fps;
+		uint32_t minBuffers;
+		uint32_t maxBuffers;
+		double eagain;
+		double drop;
+		double error;
+
+		/** read the configuration from the environment */
+		static FakeConfig load() {
+			FakeConfig cfg;
+			cfg.device = getString("KAMERA_FAKE_DEVICE", "/dev/video-fake");
+			cfg.formats = parseFormats(getString("KAMERA_FAKE_FORMATS", "YUYV:640x480,1280x720;GREY:640x480"));
+			cfg.fps = atof(getString("KAMERA_FAKE_FPS", "30").c_str());
+			cfg.minBuffers = (uint32_t) atoi(getString("KAMERA_FAKE_MIN_BUFFERS", "2").c_str());
+			cfg.maxBuffers = (uint32_t) atoi(getString("KAMERA_FAKE_MAX_BUFFERS", "8").c_str());
+			cfg.eagain = atof(getString("KAMERA_FAKE_EAGAIN", "0").c_str());
+			cfg.drop = atof(getString("KAMERA_FAKE_DROP", "0").c_str());
+			cfg.error = atof(getString("KAMERA_FAKE_ERROR", "0").c_str());
+			if (cfg.minBuffers < 1) {cfg.minBuffers = 1;}
+			if (cfg.maxBuffers < cfg.minBuffers) {cfg.maxBuffers = cfg.minBuffers;}
+			return cfg;
+		}
+
+		static std::string getString(const char* name, const char* def) {
+			const char* val = getenv(name);
+			return (val) ? (val) : (def);
+		}
+
+		/** parse "FOURCC:WxH,WxH;FOURCC:WxH" */
+		static std::vector<FakeFormat> parseFormats(const std::string& str) {
+			std::vector<FakeFormat> formats;
+			size_t pos = 0;
+			while (pos < str.size()) {
+				size_t end = str.find(';', pos);
+				if (end == std::string::npos) {end = str.size();}
+				const std::string entry = str.substr(pos, end - pos);
+				pos = end + 1;
+				const size_t colon = entry.find(':');
+				if (colon != 4) {fprintf(stderr, "[fakeV4L2] ignoring format '%s'\n", entry.c_str()); continue;}
+				FakeFormat fmt;
+				fmt.fourcc = v4l2_fourcc(entry[0], entry[1], entry[2], entry[3]);
+				if (getImageSize(fmt.fourcc, 1, 1) == 0) {fprintf(stderr, "[fakeV4L2] unsupported format '%s'\n", entry.c_str()); continue;}
+				const char* s = entry.c_str() + colon + 1;
+				unsigned w, h;
+				int n;
+				while (sscanf(s, "%ux%u%n", &w, &h, &n) == 2) {
+					fmt.sizes.push_back(std::make_pair(w, h));
+					s += n;
+					if (*s == ',') {++s;}
+				}
+				if (!fmt.sizes.empty()) {formats.push_back(fmt);}
+			}
+			return formats;
+		}
+
+		/** the number of bytes of one image. 0 if the format is not supported */
+		static uint32_t getImageSize(const uint32_t fourcc, const uint32_t w, const uint32_t h) {
+			switch (fourcc) {
+				case V4L2_PIX_FMT_YUYV:		return w*h*2;
+				case V4L2_PIX_FMT_GREY:		return w*h;
+				case V4L2_PIX_FMT_RGB24:	return w*h*3;
+				case V4L2_PIX_FMT_YUV420:	return w*h*3/2;
+				default:					return 0;
+			}
+		}
+
+		/** the number of bytes of one line (of the first plane) */
+		static uint32_t getBytesPerLine(const uint32_t fourcc, const uint32_t w) {
+			switch (fourcc) {
+				case V4L2_PIX_FMT_YUYV:		return w*2;
+				case V4L2_PIX_FMT_RGB24:	return w*3;
+				default:					return w;
+			}
+		}
+
+	};
+
+	/** one of the driver's buffers */
+	struct FakeBuffer {
+		bool queued;
+		bool done;
+		uint32_t bytesused;
+		uint32_t sequence;
+		uint32_t flags;
+		struct timeval timestamp;
+		FakeBuffer() : queued(false), done(false), bytesused(0), sequence(0), flags(0) {timestamp.tv_sec = 0; timestamp.tv_usec = 0;}
+	};
+
+	/** the pointers to the real (libc) functions */
+	struct Real {
+		int (*open) (const char*, int, ...);
+		int (*openat) (int, const char*, int, ...);
+		int (*close) (int);
+		int (*ioctl) (int, unsigned long, ...);
+		void* (*mmap) (void*, size_t, int, int, int, off_t);
+		Real() {
+			open = (int (*) (const char*, int, ...)) dlsym(RTLD_NEXT, "open");
+			openat = (int (*) (int, const char*, int, ...)) dlsym(RTLD_NEXT, "openat");
+			close = (int (*) (int)) dlsym(RTLD_NEXT, "close");
+			ioctl = (int (*) (int, unsigned long, ...)) dlsym(RTLD_NEXT, "ioctl");
+			mmap = (void* (*) (void*, size_t, int, int, int, off_t)) dlsym(RTLD_NEXT, "mmap");
+		}
+	};
+
+	static Real& real() {
+		static Real r;
+		return r;
+	}
+
+	/**
+	 * the emulated device.
+	 * all ioctls are serialized using one mutex, the capture thread
+	 * fills the queued buffers at the configured frame rate.
+	 */
+	class FakeDevice {
+
+	public:
+
+		/** ctor */
+		FakeDevice(const FakeConfig& cfg, const bool nonBlocking) :
+			cfg(cfg), nonBlocking(nonBlocking), memfd(-1), map(nullptr), bufSize(0),
+			streaming(false), sequence(0), rnd(0x2545F4914F6CDD1Dull),
+			numCaptured(0), numDropped(0), numStarved(0), numEAGAIN(0) {
+
+			// the file-descriptor handed to the application: readable while frames are waiting
+			fd = eventfd(0, EFD_NONBLOCK | EFD_SEMAPHORE | EFD_CLOEXEC);
+
+			CLEAR(fmt);
+			fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			if (!cfg.formats.empty()) {setFormat(cfg.formats[0].fourcc, cfg.formats[0].sizes[0].first, cfg.formats[0].sizes[0].second);}
+
+		}
+
+		/** dtor */
+		~FakeDevice() {
+			streamOff();
+			freeBuffers();
+			fprintf(stderr, "[fakeV4L2] captured: %llu, dropped: %llu, starved: %llu, injected EAGAIN: %llu\n",
+					(unsigned long long) numCaptured, (unsigned long long) numDropped, (unsigned long long) numStarved, (unsigned long long) numEAGAIN);
+			real().close(fd);
+		}
+
+		/** the file-descriptor handed to the application */
+		int getFD() const {return fd;}
+
+		/** map the driver's buffers. the offset selects the buffer (see QUERYBUF) */
+		void* mmap(void* addr, const size_t length, const int prot, const int flags, const off_t offset) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (memfd == -1 || offset < 0 || (size_t) offset + length > bufSize * buffers.size()) {errno = EINVAL; return MAP_FAILED;}
+			return real().mmap(addr, length, prot, flags, memfd, offset);
+		}
+
+		/**
+		 * handle one ioctl. like the kernel, only the lower 32 bits of the request are used
+		 * (callers passing the request as int sign-extend it)
+		 * @return 0 or the error number
+		 */
+		int ioctl(const uint32_t request, void* arg) {
+
+			switch (request) {
+
+				case VIDIOC_QUERYCAP: {
+					struct v4l2_capability* cap = (struct v4l2_capability*) arg;
+					CLEAR(*cap);
+					strncpy((char*) cap->driver, "fakeV4L2", sizeof(cap->driver) - 1);
+					strncpy((char*) cap->card, "fake streaming camera", sizeof(cap->card) - 1);
+					strncpy((char*) cap->bus_info, "platform:fake", sizeof(cap->bus_info) - 1);
+					cap->version = (1 << 16);		// 1.0.0
+					cap->device_caps = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+					cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+					return 0;
+				}
+
+				case VIDIOC_ENUM_FMT: {
+					struct v4l2_fmtdesc* desc = (struct v4l2_fmtdesc*) arg;
+					if (desc->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || desc->index >= cfg.formats.size()) {return EINVAL;}
+					const uint32_t index = desc->index;
+					CLEAR(*desc);
+					desc->index = index;
+					desc->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+					desc->pixelformat = cfg.formats[index].fourcc;
+					memcpy(desc->description, &desc->pixelformat, 4);
+					return 0;
+				}
+
+				case VIDIOC_ENUM_FRAMESIZES: {
+					struct v4l2_frmsizeenum* size = (struct v4l2_frmsizeenum*) arg;
+					const FakeFormat* f = getFormat(size->pixel_format);
+					if (!f || size->index >= f->sizes.size()) {return EINVAL;}
+					size->type = V4L2_FRMSIZE_TYPE_DISCRETE;
+					size->discrete.width = f->sizes[size->index].first;
+					size->discrete.height = f->sizes[size->index].second;
+					return 0;
+				}
+
+				case VIDIOC_G_FMT: {
+					struct v4l2_format* f = (struct v4l2_format*) arg;
+					if (f->type != V4L2_BUF_TYPE_VIDEO_CAPTURE) {return EINVAL;}
+					std::lock_guard<std::mutex> lock(mutex);
+					*f = fmt;
+					return 0;
+				}
+
+				case VIDIOC_S_FMT:
+				case VIDIOC_TRY_FMT: {
+					struct v4l2_format* f = (struct v4l2_format*) arg;
+					if (f->type != V4L2_BUF_TYPE_VIDEO_CAPTURE) {return EINVAL;}
+					std::lock_guard<std::mutex> lock(mutex);
+					const struct v4l2_format old = fmt;
+					if (request == VIDIOC_S_FMT && !buffers.empty()) {return EBUSY;}
+					setFormat(f->fmt.pix.pixelformat, f->fmt.pix.width, f->fmt.pix.height);
+					*f = fmt;
+					if (request == VIDIOC_TRY_FMT) {fmt = old;}
+					return 0;
+				}
+
+				case VIDIOC_G_PARM:
+				case VIDIOC_S_PARM: {
+					struct v4l2_streamparm* p = (struct v4l2_streamparm*) arg;
+					if (p->type != V4L2_BUF_TYPE_VIDEO_CAPTURE) {return EINVAL;}
+					std::lock_guard<std::mutex> lock(mutex);
+					if (request == VIDIOC_S_PARM && p->parm.capture.timeperframe.numerator > 0) {
+						cfg.fps = (double) p->parm.capture.timeperframe.denominator / p->parm.capture.timeperframe.numerator;
+					}
+					CLEAR(p->parm);
+					p->parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
+					p->parm.capture.timeperframe.numerator = 1000;
+					p->parm.capture.timeperframe.denominator = (uint32_t) (cfg.fps * 1000);
+					return 0;
+				}
+
+				case VIDIOC_REQBUFS:	return requestBuffers(*(struct v4l2_requestbuffers*) arg);
+				case VIDIOC_QUERYBUF:	return queryBuffer(*(struct v4l2_buffer*) arg);
+				case VIDIOC_QBUF:		return enqueue(*(struct v4l2_buffer*) arg);
+				case VIDIOC_DQBUF:		return dequeue(*(struct v4l2_buffer*) arg);
+
+				case VIDIOC_STREAMON: {
+					if (*(int*) arg != V4L2_BUF_TYPE_VIDEO_CAPTURE) {return EINVAL;}
+					std::lock_guard<std::mutex> lock(mutex);
+					if (buffers.empty()) {return EINVAL;}
+					if (streaming) {return 0;}
+					streaming = true;
+					thread = std::thread(&FakeDevice::capture, this);
+					return 0;
+				}
+
+				case VIDIOC_STREAMOFF: {
+					if (*(int*) arg != V4L2_BUF_TYPE_VIDEO_CAPTURE) {return EINVAL;}
+					streamOff();
+					return 0;
+				}
+
+				default:
+					return ENOTTY;
+
+			}
+
+		}
+
+	private:
+
+		FakeConfig cfg;
+
+		/** was the device opened with O_NONBLOCK? */
+		const bool nonBlocking;
+
+		/** the eventfd handed to the application */
+		int fd;
+
+		/** the shared memory holding all buffers, and its mapping */
+		int memfd;
+		uint8_t* map;
+
+		/** the (page-aligned) size of one buffer */
+		size_t bufSize;
+
+		struct v4l2_format fmt;
+		std::vector<FakeBuffer> buffers;
+
+		/** the buffers queued by the application (to capture into) and the captured ones (to dequeue) */
+		std::deque<uint32_t> queued;
+		std::deque<uint32_t> done;
+
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::thread thread;
+		bool streaming;
+
+		/** the driver's frame counter */
+		uint32_t sequence;
+
+		/** xorshift state for the injected errors */
+		uint64_t rnd;
+
+		uint64_t numCaptured;
+		uint64_t numDropped;
+		uint64_t numStarved;
+		uint64_t numEAGAIN;
+
+
+		/** reset the given struct's memory to zeros */
+		template <typename T> static void CLEAR(T& t) {memset(&t, 0, sizeof(t));}
+
+		/** random number within [0:1] */
+		double random() {
+			rnd ^= rnd << 13; rnd ^= rnd >> 7; rnd ^= rnd << 17;
+			return (double) (rnd >> 11) / (double) (1ull << 53);
+		}
+
+		const FakeFormat* getFormat(const uint32_t fourcc) const {
+			for (const FakeFormat& f : cfg.formats) {if (f.fourcc == fourcc) {return &f;}}
+			return nullptr;
+		}
+
+		/** use the requested format, if supported, or the closest one (mutex must be held) */
+		void setFormat(const uint32_t fourcc, const uint32_t width, const uint32_t height) {
+			const FakeFormat* f = getFormat(fourcc);
+			if (!f) {f = &cfg.formats[0];}
+			std::pair<uint32_t, uint32_t> size = f->sizes[0];
+			for (const std::pair<uint32_t, uint32_t>& s : f->sizes) {
+				if (s.first == width && s.second == height) {size = s;}
+			}
+			fmt.fmt.pix.pixelformat = f->fourcc;
+			fmt.fmt.pix.width = size.first;
+			fmt.fmt.pix.height = size.second;
+			fmt.fmt.pix.field = V4L2_FIELD_NONE;
+			fmt.fmt.pix.bytesperline = FakeConfig::getBytesPerLine(f->fourcc, size.first);
+			fmt.fmt.pix.sizeimage = FakeConfig::getImageSize(f->fourcc, size.first, size.second);
+			fmt.fmt.pix.colorspace = V4L2_COLORSPACE_SRGB;
+		}
+
+		/** unmap and free all buffers (stream must be off) */
+		void freeBuffers() {
+			if (map) {munmap(map, bufSize * buffers.size()); map = nullptr;}
+			if (memfd != -1) {real().close(memfd); memfd = -1;}
+			buffers.clear();
+			queued.clear();
+			done.clear();
+		}
+
+		int requestBuffers(struct v4l2_requestbuffers& req) {
+
+			if (req.type != V4L2_BUF_TYPE_VIDEO_CAPTURE) {return EINVAL;}
+			if (req.memory != V4L2_MEMORY_MMAP) {return EINVAL;}			// USERPTR / DMABUF are not emulated
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (streaming) {return EBUSY;}
+			freeBuffers();
+			if (req.count == 0) {return 0;}
+
+			uint32_t count = req.count;
+			if (count < cfg.minBuffers) {count = cfg.minBuffers;}
+			if (count > cfg.maxBuffers) {count = cfg.maxBuffers;}
+
+			const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+			bufSize = (fmt.fmt.pix.sizeimage + pageSize - 1) / pageSize * pageSize;
+
+			memfd = memfd_create("fakeV4L2", MFD_CLOEXEC);
+			if (memfd == -1) {return ENOMEM;}
+			if (ftruncate(memfd, (off_t) (bufSize * count)) != 0) {real().close(memfd); memfd = -1; return ENOMEM;}
+			map = (uint8_t*) real().mmap(NULL, bufSize * count, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+			if (map == MAP_FAILED) {map = nullptr; real().close(memfd); memfd = -1; return ENOMEM;}
+
+			buffers.resize(count);
+			req.count = count;
+			return 0;
+
+		}
+
+		/** describe the given buffer (mutex must be held) */
+		void describe(const uint32_t index, struct v4l2_buffer& buf) const {
+			const FakeBuffer& b = buffers[index];
+			const uint32_t type = buf.type;
+			CLEAR(buf);
+			buf.index = index;
+			buf.type = type;
+			buf.memory = V4L2_MEMORY_MMAP;
+			buf.m.offset = (uint32_t) (index * bufSize);
+			buf.length = fmt.fmt.pix.sizeimage;
+			buf.bytesused = b.bytesused;
+			buf.sequence = b.sequence;
+			buf.timestamp = b.timestamp;
+			buf.field = V4L2_FIELD_NONE;
+			buf.flags = b.flags | V4L2_BUF_FLAG_MAPPED | V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+			if (b.queued)	{buf.flags |= V4L2_BUF_FLAG_QUEUED;}
+			if (b.done)		{buf.flags |= V4L2_BUF_FLAG_DONE;}
+		}
+
+		int queryBuffer(struct v4l2_buffer& buf) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (buf.type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buf.index >= buffers.size()) {return EINVAL;}
+			describe(buf.index, buf);
+			return 0;
+		}
+
+		int enqueue(struct v4l2_buffer& buf) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (buf.type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buf.memory != V4L2_MEMORY_MMAP || buf.index >= buffers.size()) {return EINVAL;}
+			FakeBuffer& b = buffers[buf.index];
+			if (b.queued || b.done) {return EINVAL;}
+			b.queued = true;
+			queued.push_back(buf.index);
+			describe(buf.index, buf);
+			changed.notify_all();
+			return 0;
+		}
+
+		int dequeue(struct v4l2_buffer& buf) {
+
+			if (buf.type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buf.memory != V4L2_MEMORY_MMAP) {return EINVAL;}
+
+			std::unique_lock<std::mutex> lock(mutex);
+			if (!streaming) {return EINVAL;}
+
+			if (nonBlocking) {
+				if (done.empty()) {return EAGAIN;}
+				if (cfg.eagain > 0 && random() < cfg.eagain) {++numEAGAIN; return EAGAIN;}		// spurious wakeup
+			} else {
+				changed.wait(lock, [this] {return !done.empty() || !streaming;});
+				if (!streaming) {return EINVAL;}
+			}
+
+			const uint32_t index = done.front();
+			done.pop_front();
+			buffers[index].done = false;
+			describe(index, buf);
+
+			// one frame less waiting -> decrement the eventfd's counter
+			uint64_t val;
+			if (::read(fd, &val, sizeof(val)) != sizeof(val)) {;}
+
+			return 0;
+
+		}
+
+		void streamOff() {
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!streaming) {return;}
+				streaming = false;
+				changed.notify_all();
+			}
+			thread.join();
+
+			// all buffers are removed from the queues
+			std::lock_guard<std::mutex> lock(mutex);
+			for (FakeBuffer& b : buffers) {b.queued = false; b.done = false;}
+			queued.clear();
+			done.clear();
+			uint64_t val;
+			while (::read(fd, &val, sizeof(val)) == sizeof(val)) {;}
+
+		}
+
+		/** the capture thread */
+		void capture() {
+
+			std::unique_lock<std::mutex> lock(mutex);
+			std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+			while (streaming) {
+
+				// wait for the next frame
+				if (cfg.fps > 0) {
+					next += std::chrono::nanoseconds((int64_t) (1e9 / cfg.fps));
+					while (streaming && changed.wait_until(lock, next) != std::cv_status::timeout) {;}
+				} else {
+					changed.wait(lock, [this] {return !queued.empty() || !streaming;});
+				}
+				if (!streaming) {break;}
+
+				const uint32_t seq = sequence++;
+				if (cfg.drop > 0 && random() < cfg.drop)	{++numDropped; continue;}
+				if (queued.empty())							{++numStarved; continue;}		// nothing to capture into
+
+				// "capture" the frame
+				const uint32_t index = queued.front();
+				queued.pop_front();
+				FakeBuffer& b = buffers[index];
+				uint8_t* data = map + index * bufSize;
+				memset(data, seq & 0xFF, fmt.fmt.pix.sizeimage);
+				memcpy(data, &seq, sizeof(seq));
+
+				struct timespec ts;
+				clock_gettime(CLOCK_MONOTONIC, &ts);
+				b.timestamp.tv_sec = ts.tv_sec;
+				b.timestamp.tv_usec = ts.tv_nsec / 1000;
+				b.sequence = seq;
+				b.bytesused = fmt.fmt.pix.sizeimage;
+				b.flags = (cfg.error > 0 && random() < cfg.error) ? (V4L2_BUF_FLAG_ERROR) : (0);
+				b.queued = false;
+				b.done = true;
+				done.push_back(index);
+				++numCaptured;
+
+				// wake up the application
+				const uint64_t one = 1;
+				if (::write(fd, &one, sizeof(one)) != sizeof(one)) {;}
+				changed.notify_all();
+
+			}
+
+		}
+
+	};
+
+	/** the currently open fake device (only one at a time) */
+	static std::mutex deviceMutex;
+	static FakeDevice* device = nullptr;
+
+	/** the configuration, read on first use */
+	static const FakeConfig& config() {
+		static FakeConfig cfg = FakeConfig::load();
+		return cfg;
+	}
+
+	/** get the fake device, if the given file-descriptor belongs to it */
+	static FakeDevice* getDevice(const int fd) {
+		std::lock_guard<std::mutex> lock(deviceMutex);
+		return (device && device->getFD() == fd) ? (device) : (nullptr);
+	}
+
+	/** open the fake device, if the path matches. @return the fd, -1 on error, -2 if the path does not match */
+	static int openDevice(const char* path, const int flags) {
+		if (!path || config().device != path) {return -2;}
+		if (config().formats.empty()) {errno = ENODEV; return -1;}
+		std::lock_guard<std::mutex> lock(deviceMutex);
+		if (device) {errno = EBUSY; return -1;}
+		device = new FakeDevice(config(), (flags & O_NONBLOCK) != 0);
+		return device->getFD();
+	}
+
+}
+
+extern "C" {
+
+	int open(const char* path, int flags, ...) {
+		const int fd = openDevice(path, flags);
+		if (fd != -2) {return fd;}
+		mode_t mode = 0;
+		if (flags & (O_CREAT | O_TMPFILE)) {va_list args; va_start(args, flags); mode = va_arg(args, mode_t); va_end(args);}
+		return real().open(path, flags, mode);
+	}
+
+	int open64(const char* path, int flags, ...) {
+		const int fd = openDevice(path, flags);
+		if (fd != -2) {return fd;}
+		mode_t mode = 0;
+		if (flags & (O_CREAT | O_TMPFILE)) {va_list args; va_start(args, flags); mode = va_arg(args, mode_t); va_end(args);}
+		return real().open(path, flags | O_LARGEFILE, mode);
+	}
+
+	int openat(int dirfd, const char* path, int flags, ...) {
+		const int fd = openDevice(path, flags);
+		if (fd != -2) {return fd;}
+		mode_t mode = 0;
+		if (flags & (O_CREAT | O_TMPFILE)) {va_list args; va_start(args, flags); mode = va_arg(args, mode_t); va_end(args);}
+		return real().openat(dirfd, path, flags, mode);
+	}
+
+	int close(int fd) {
+		{
+			std::lock_guard<std::mutex> lock(deviceMutex);
+			if (device && device->getFD() == fd) {
+				delete device;
+				device = nullptr;
+				return 0;
+			}
+		}
+		return real().close(fd);
+	}
+
+	int ioctl(int fd, unsigned long request, ...) __THROW {
+		va_list args;
+		va_start(args, request);
+		void* arg = va_arg(args, void*);
+		va_end(args);
+		FakeDevice* dev = getDevice(fd);
+		if (!dev) {return real().ioctl(fd, request, arg);}
+		const int ret = dev->ioctl((uint32_t) request, arg);
+		if (ret == 0) {return 0;}
+		errno = ret;
+		return -1;
+	}
+
+	void* mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset) __THROW {
+		FakeDevice* dev = getDevice(fd);
+		if (!dev) {return real().mmap(addr, length, prot, flags, fd, offset);}
+		return dev->mmap(addr, length, prot, flags, offset);
+	}
+
+	void* mmap64(void* addr, size_t length, int prot, int flags, int fd, off64_t offset) __THROW {
+		return mmap(addr, length, prot, flags, fd, (off_t) offset);
+	}
+
+}